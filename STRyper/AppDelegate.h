@@ -42,11 +42,22 @@
 /// If the persistent store cannot be loaded, the method shows an alert that proposes to create a new one and copy the old one, or to quit.
 @property (readonly, strong) NSPersistentContainer *persistentContainer;
 
-/// Returns the ``persistentContainer``'s view context.
+/// Returns the context used on the main thread (the "view" context).
 ///
 /// This context is the one use by most methods of this application. It has an undo manager that is used by the main window.
+///
+/// This context is a child of the ``writerContext``, hence saving it does not write to disk.
+/// Changes that other contexts of the ``persistentContainer`` save to the store are merged into this context.
+/// In case of conflict, the values of properties modified in this context win over those saved by other contexts.
 @property (readonly, strong, nonatomic) NSManagedObjectContext *managedObjectContext;
 
+/// The context that writes the changes saved in the ``managedObjectContext`` to the persistent store, on a private queue.
+///
+/// Changes are written after each save of the ``managedObjectContext``, asynchronously. See ``writeSavedChangesToStore:``.
+///
+/// This context should only be used to merge changes that are not notified by a save, like batch deletions.
+@property (readonly, strong, nonatomic) NSManagedObjectContext *writerContext;
+
 /// A context that is a child of ``managedObjectContext`` and has no undo manager .
 ///
 /// The same context is returned at each call.
@@ -60,10 +71,26 @@
 
 /// Saves the ``managedObjectContext``, if it has changes.
 ///
+/// The saved changes are then written to the persistent store in the background, by the ``writerContext``.
+///
 /// If saving fails, the method tries to recover from validation errors by calling ``recoverFromErrorInContext:showLog:``.
 /// - Parameter sender: The sender of the message (ignored by the method).
 - (IBAction)saveAction:(id)sender;
 
+/// Writes the changes saved in the ``managedObjectContext`` to the persistent store, and returns when they are written.
+///
+/// This method should be called before another context of the ``persistentContainer`` fetches objects that may have been modified in the ``managedObjectContext``,
+/// as these contexts read the store.
+/// - Parameter error: On output, any error that prevented writing the changes.
+/// - Returns: Whether the changes could be written.
+- (BOOL)writeSavedChangesToStore:(NSError **)error;
+
+/// Schedules a save of the ``managedObjectContext`` by ``saveAction:``, which occurs when no new call is made for a second.
+///
+/// Calls made in quick succession, for instance during successive edits in a table, thus result in a single save.
+/// The save occurs at most 5 seconds after the first call, and a call to ``saveAction:`` performs the scheduled save immediately.
+- (void)setNeedsSave;
+
 
 /// Tries to recover from an error that prevented saving a context, by undoing recent changes and trying to save the context.
 ///
@@ -81,6 +108,10 @@
 /// - Parameter sender: The object that sent the message. It is ignored by the method.
 - (IBAction)showHelp:(id)sender;
 
+/// Checks that the files containing the fluorescence data of traces (see ``BlobStore``) are present and unaltered, and shows the result in an alert.
+/// - Parameter sender: The object that sent the message. It is ignored by the method.
+- (IBAction)verifyTraceData:(id)sender;
+
 
 /// Keys of the user defaults. See their default value in the implementation.
 typedef NSString *const UserDefaultKey;
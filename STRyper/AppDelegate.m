@@ -28,6 +28,11 @@
 #import "GenotypeTableController.h"
 #import "DetailedViewController.h"
 #import "SmartFolder.h"
+#import "BlobStore.h"
+#import "ProgressWindow.h"
+
+/// The key of the persistent store metadata indicating that the fluorescence data of traces has been stored as references to blobs (see ``FluoTrace/compactStoredRawData``).
+static NSString *const StoreTraceDataCompactedKey = @"TraceDataCompacted";
 
 @interface AppDelegate ()
 
@@ -41,6 +46,13 @@
 @end
 
 
+/// Statistics on the durations of saves.
+typedef struct SaveStatistics {
+	NSUInteger nSaves;
+	CFTimeInterval totalTime, maxTime;
+} SaveStatistics;
+
+
 @implementation AppDelegate {
 	
 	/// The application preference window.
@@ -48,6 +60,13 @@
 	NSTimer *saveTimer;			/// A timer that we use to save at time intervals.
 	BOOL quitWithoutCleaning;	/// whether we should terminate the application without emptying the trash.
 	
+	/// The time of the first call to ``setNeedsSave`` since the last save, or 0 if no save is pending.
+	CFAbsoluteTime firstSaveRequestTime;
+	
+	/// Statistics on the time taken by saves of the view context (on the main thread)
+	/// and by writes of the writer context to the store (on its queue), which we log when a save is slow.
+	SaveStatistics viewSaveStatistics, storeWriteStatistics;
+	
 }
 
 
@@ -89,7 +108,7 @@ AnnotateAdditionalPeaks = @"AnnotateAdditionalPeaks",
 BottomTab = @"BottomTab",
 CaseSensitiveSampleSearch = @"CaseSensitiveSampleSearch";
 
-@synthesize managedObjectContext = _managedObjectContext, childContext = _childContext;
+@synthesize managedObjectContext = _managedObjectContext, writerContext = _writerContext, childContext = _childContext;
 
 
 + (void)initialize {
@@ -172,10 +191,14 @@ CaseSensitiveSampleSearch = @"CaseSensitiveSampleSearch";
 		NSDictionary *data = [NSPersistentStoreCoordinator metadataForPersistentStoreOfType:NSSQLiteStoreType URL:url options:nil error:nil];
 		if(data) {
 			NSArray *identifiers = data[NSStoreModelVersionIdentifiersKey];
-			if(identifiers && ![identifiers containsObject:@"1.2"]) {
+			/// Crosstalk detection was improved in version 1.2 of the model, which later versions include.
+			if(identifiers && ![identifiers containsObject:@"1.2"] && ![identifiers containsObject:@"1.3"]) {
 				NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:Chromatogram.entity.name];
 				NSManagedObjectContext *MOC = self.persistentContainer.newBackgroundContext;
-				[MOC performBlockAndWait:^{
+				/// This is done in the background, as it may take a while. Saved batches are merged into the view context (see ``contextDidSave:``),
+				/// and our changes must not override changes made to other attributes in the meantime.
+				MOC.mergePolicy = NSMergeByPropertyObjectTrumpMergePolicy;
+				[MOC performBlock:^{
 					NSArray *samples = [MOC executeFetchRequest:request error:nil];
 					int n = 0;
 					for(Chromatogram *sample in samples) {
@@ -191,11 +214,17 @@ CaseSensitiveSampleSearch = @"CaseSensitiveSampleSearch";
 							}
 						}
 					}
+					if(MOC.hasChanges) {
+						[MOC save:nil];
+					}
 				}];
 			}
 		}
 	}
 	
+	[self compactTraceData];
+	[self removeUnusedBlobs];
+	
 	/// We load the main window.
 	NSWindow *mainWindow = MainWindowController.sharedController.window;
 	if(!mainWindow) {
@@ -252,6 +281,126 @@ CaseSensitiveSampleSearch = @"CaseSensitiveSampleSearch";
 }
 
 
+/// Moves the fluorescence data that earlier versions stored in the rows of traces to the blob store, so that these rows only contain references.
+///
+/// This is done once per database, in the background. Traces are processed in batches, and the context is reset between batches to limit memory use.
+-(void)compactTraceData {
+	NSPersistentStoreCoordinator *coordinator = self.persistentContainer.persistentStoreCoordinator;
+	NSPersistentStore *store = coordinator.persistentStores.firstObject;
+	if(!store || !BlobStore.sharedStore || [store.metadata[StoreTraceDataCompactedKey] boolValue]) {
+		return;
+	}
+	
+	NSManagedObjectContext *MOC = self.persistentContainer.newBackgroundContext;
+	/// Our changes only concern the `rawData` attribute, which must not override changes to other attributes made in the view context.
+	MOC.mergePolicy = NSMergeByPropertyObjectTrumpMergePolicy;
+	[MOC performBlock:^{
+		NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:Trace.entity.name];
+		request.resultType = NSManagedObjectIDResultType;
+		NSError *error;
+		NSArray<NSManagedObjectID *> *traceIDs = [MOC executeFetchRequest:request error:&error];
+		if(!traceIDs) {
+			NSLog(@"Failed to fetch traces: %@", error);
+			return;
+		}
+		
+		NSUInteger nCompacted = 0, n = 0;
+		for(NSManagedObjectID *traceID in traceIDs) {
+			@autoreleasepool {
+				Trace *trace = [MOC existingObjectWithID:traceID error:nil];
+				if([trace compactStoredRawData]) {
+					nCompacted++;
+				}
+				if(++n % 500 == 0) {
+					if(MOC.hasChanges && ![MOC save:&error]) {
+						NSLog(@"Failed to save compacted trace data: %@", error);
+						return;
+					}
+					[MOC reset];
+				}
+			}
+		}
+		
+		/// The metadata is written with the next save of the store.
+		NSMutableDictionary *metadata = [coordinator metadataForPersistentStore:store].mutableCopy;
+		metadata[StoreTraceDataCompactedKey] = @YES;
+		[coordinator setMetadata:metadata forPersistentStore:store];
+		if(MOC.hasChanges && ![MOC save:&error]) {
+			NSLog(@"Failed to save compacted trace data: %@", error);
+			return;
+		}
+		if(nCompacted > 0) {
+			NSLog(@"Moved the fluorescence data of %ld traces to the blob store.", nCompacted);
+		}
+	}];
+}
+
+
+/// Removes the blobs containing fluorescence data that are not used by traces, if traces were deleted or blobs were written since the last time.
+///
+/// Blobs written by an import that was cancelled, failed or was not saved are removed this way.
+///
+/// This is done in the background. Blobs written after this method is called (by imports) are not removed.
+-(void)removeUnusedBlobs {
+	BlobStore *blobStore = BlobStore.sharedStore;
+	if(!blobStore.needsCollection) {
+		return;
+	}
+	NSDate *date = NSDate.date;
+	NSManagedObjectContext *MOC = self.persistentContainer.newBackgroundContext;
+	[MOC performBlock:^{
+		NSSet *references = [Trace blobReferencesInContext:MOC];
+		if(references) {
+			NSUInteger nRemoved = [blobStore removeBlobsNotReferencedBy:references olderThan:date];
+			if(nRemoved > 0) {
+				NSLog(@"Removed %ld unused trace data files.", nRemoved);
+			}
+		}
+	}];
+}
+
+
+- (IBAction)verifyTraceData:(id)sender {
+	BlobStore *blobStore = BlobStore.sharedStore;
+	NSWindow *window = MainWindowController.sharedController.window;
+	if(!blobStore) {
+		[[NSAlert alertWithError:[NSError errorWithDescription:@"The trace data folder could not be accessed." suggestion:@""]] beginSheetModalForWindow:window completionHandler:nil];
+		return;
+	}
+	
+	NSProgress *progress = [NSProgress progressWithTotalUnitCount:-1];
+	progress.localizedDescription = @"Verifying trace data…";
+	ProgressWindow *progressWindow = ProgressWindow.new;
+	[progressWindow showProgressWindowForProgress:progress afterDelay:0.5 modal:YES parentWindow:window];
+	
+	NSManagedObjectContext *MOC = self.persistentContainer.newBackgroundContext;
+	[MOC performBlock:^{
+		NSSet *references = [Trace blobReferencesInContext:MOC];
+		progress.totalUnitCount = references.count;
+		NSArray *invalidReferences = references? [blobStore invalidReferencesAmong:references progress:progress] : nil;
+		dispatch_async(dispatch_get_main_queue(), ^{
+			[progressWindow stopShowingProgressAndClose];
+			if(progress.isCancelled) {
+				return;
+			}
+			NSAlert *alert = NSAlert.new;
+			if(!references) {
+				alert.alertStyle = NSAlertStyleCritical;
+				alert.messageText = @"The trace data could not be read from the database.";
+			} else if(invalidReferences.count == 0) {
+				alert.messageText = @"The trace data is intact.";
+				alert.informativeText = [NSString stringWithFormat:@"%ld data files were verified.", references.count];
+			} else {
+				alert.alertStyle = NSAlertStyleCritical;
+				alert.messageText = [NSString stringWithFormat:@"%ld of %ld trace data files are missing or damaged.", invalidReferences.count, references.count];
+				alert.informativeText = @"The curves of the affected traces cannot be shown. The corresponding samples should be imported again.";
+			}
+			[alert beginSheetModalForWindow:window completionHandler:nil];
+		});
+	}];
+}
+
+
 /// Puts the content found in the trash folder (if not emptied) into a folder called "recovered items".
 -(void)restoreTrash {
 	FolderListController *folderListController = FolderListController.sharedController;
@@ -501,17 +650,90 @@ CaseSensitiveSampleSearch = @"CaseSensitiveSampleSearch";
 
 - (NSManagedObjectContext *)managedObjectContext {
 	if (!_managedObjectContext) {
-		_managedObjectContext = self.persistentContainer.viewContext;
-		if(_managedObjectContext) {
+		NSPersistentContainer *container = self.persistentContainer;
+		NSManagedObjectContext *writerContext = container.newBackgroundContext;
+		if(writerContext) {
+			/// The view context is a child of a context that writes to the store on a private queue, so that disk writes do not block the UI.
+			/// The view context is not a child of the container's viewContext, which we do not use.
+			writerContext.undoManager = nil;
+			_writerContext = writerContext;
+			_managedObjectContext = [[NSManagedObjectContext alloc] initWithConcurrencyType:NSMainQueueConcurrencyType];
+			_managedObjectContext.parentContext = writerContext;
 			CDUndoManager *undoManager = CDUndoManager.new;
 			undoManager.managedObjectContext = _managedObjectContext;
-			_managedObjectContext.automaticallyMergesChangesFromParent = YES;
+			
+			/// Changes made in the UI win over conflicting changes saved by background contexts, property by property,
+			/// so that a conflict does not make saving fail and recent actions get undone.
+			/// The outcome is deterministic, but a background change (e.g., crosstalk detection, or sizing and offsets applied by a context that saves to the store)
+			/// is silently overwritten if the same property of the same object was modified in the view context before the background change was merged.
+			/// Other properties of the object keep their background values.
+			_managedObjectContext.mergePolicy = NSMergeByPropertyObjectTrumpMergePolicy;
+			writerContext.mergePolicy = NSMergeByPropertyObjectTrumpMergePolicy;
+			
+			NSNotificationCenter *center = NSNotificationCenter.defaultCenter;
+			[center addObserver:self selector:@selector(contextWillSave:) name:NSManagedObjectContextWillSaveNotification object:_managedObjectContext];
+			[center addObserver:self selector:@selector(contextDidSave:) name:NSManagedObjectContextDidSaveNotification object:nil];
 		}
 	}
 	return _managedObjectContext;
 }
 
 
+/// Gives permanent IDs to objects inserted in the view context before it is saved.
+///
+/// Objects saved to a parent context keep temporary IDs otherwise, even after the parent has saved, and these IDs are used to retrieve objects in other contexts.
+- (void)contextWillSave:(NSNotification *)notification {
+	NSManagedObjectContext *context = notification.object;
+	NSArray *insertedObjects = [context.insertedObjects.allObjects filteredArrayUsingBlock:^BOOL(NSManagedObject *object, NSUInteger idx) {
+		return object.objectID.isTemporaryID;
+	}];
+	if(insertedObjects.count > 0) {
+		NSError *error;
+		if(![context obtainPermanentIDsForObjects:insertedObjects error:&error]) {
+			NSLog(@"Failed to obtain permanent IDs: %@", error);
+		}
+	}
+}
+
+
+/// Writes the changes saved in the view context to the store, and merges changes that other contexts of the persistent container saved to the store
+/// into the writer and view contexts.
+///
+/// This method may be called on any thread.
+- (void)contextDidSave:(NSNotification *)notification {
+	NSManagedObjectContext *context = notification.object;
+	if(context == _managedObjectContext) {
+		[self writeToStoreInBackground];
+		return;
+	}
+	
+	/// We ignore child contexts (whose changes reach the store via their parent), the writer context and contexts of other coordinators.
+	if(context == _writerContext || context.parentContext || context.persistentStoreCoordinator != _writerContext.persistentStoreCoordinator) {
+		return;
+	}
+	
+	/// The notification contains objects of the saved context, which we must not use on another thread. Object IDs can be.
+	NSMutableDictionary *changes = NSMutableDictionary.new;
+	NSDictionary *userInfo = notification.userInfo;
+	for(NSString *key in @[NSInsertedObjectsKey, NSUpdatedObjectsKey, NSDeletedObjectsKey]) {
+		NSSet<NSManagedObject *> *objects = userInfo[key];
+		if(objects.count > 0) {
+			changes[key] = [objects valueForKeyPath:@"@distinctUnionOfObjects.objectID"];
+		}
+	}
+	if(changes.count == 0) {
+		return;
+	}
+	
+	/// The view context takes the changes from its parent, which must therefore be merged first.
+	/// Merging on the main queue avoids waiting for the view context on the queue of the saved context.
+	dispatch_async(dispatch_get_main_queue(), ^{
+		[NSManagedObjectContext mergeChangesFromRemoteContextSave:changes intoContexts:@[self->_writerContext]];
+		[NSManagedObjectContext mergeChangesFromRemoteContextSave:changes intoContexts:@[self->_managedObjectContext]];
+	});
+}
+
+
 - (NSManagedObjectContext *)childContext {
 	if(!_childContext) {
 		NSManagedObjectContext *temporaryContext = [[NSManagedObjectContext alloc] initWithConcurrencyType:NSMainQueueConcurrencyType];
@@ -542,7 +764,32 @@ CaseSensitiveSampleSearch = @"CaseSensitiveSampleSearch";
 }
 
 
+/// The time without new call to ``setNeedsSave`` after which the context is saved.
+static const CFTimeInterval saveCoalescingInterval = 1.0;
+
+/// The maximum time between a call to ``setNeedsSave`` and the save.
+static const CFTimeInterval maxSaveDelay = 5.0;
+
+/// The duration of a save above which it is logged.
+static const CFTimeInterval slowSaveDuration = 0.1;
+
+
+- (void)setNeedsSave {
+	CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+	if(firstSaveRequestTime == 0) {
+		firstSaveRequestTime = now;
+	}
+	[NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(saveAction:) object:self];
+	CFTimeInterval delay = MIN(saveCoalescingInterval, firstSaveRequestTime + maxSaveDelay - now);
+	[self performSelector:@selector(saveAction:) withObject:self afterDelay:MAX(delay, 0)];
+}
+
+
 - (IBAction)saveAction:(id)sender {
+	/// A save supersedes any scheduled save.
+	[NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(saveAction:) object:self];
+	firstSaveRequestTime = 0;
+	
 	NSManagedObjectContext *context = self.managedObjectContext;
 
 	if (![context commitEditing]) {
@@ -550,7 +797,7 @@ CaseSensitiveSampleSearch = @"CaseSensitiveSampleSearch";
 	}
 	
 	NSError *error = nil;
-	if (context.hasChanges && ![context save:&error]) {
+	if (context.hasChanges && ![self saveContext:context error:&error]) {
 		NSString *log = [MainWindowController.sharedController populateErrorLogWithError:error];
 		NSError *postedError = [NSError errorWithDescription:@"Sorry. The database could not be saved because of an inconsistency in the data." suggestion:@"The last action(s) will be undone to resolve the issue."];
 		
@@ -565,6 +812,84 @@ CaseSensitiveSampleSearch = @"CaseSensitiveSampleSearch";
 }
 
 
+/// Adds the duration of a save to statistics, and logs it if the save is slow.
+static void recordSaveDuration(SaveStatistics *statistics, CFTimeInterval duration, NSString *description) {
+	statistics->nSaves++;
+	statistics->totalTime += duration;
+	statistics->maxTime = MAX(statistics->maxTime, duration);
+	if(duration > slowSaveDuration) {
+		NSLog(@"%@ took %.0f ms (%ld saves, mean: %.0f ms, max: %.0f ms).", description,
+			  duration * 1000, statistics->nSaves, statistics->totalTime / statistics->nSaves * 1000, statistics->maxTime * 1000);
+	}
+}
+
+
+/// Saves the view context and records the time taken, which is logged if the save is slow.
+///
+/// The changes are written to the store later, in the background, by ``contextDidSave:``.
+- (BOOL)saveContext:(NSManagedObjectContext *)context error:(NSError **)error {
+	CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+	BOOL saved = [context save:error];
+	recordSaveDuration(&viewSaveStatistics, CFAbsoluteTimeGetCurrent() - start, @"Saving the database");
+	return saved;
+}
+
+
+/// Saves the writer context, which writes its changes to the store, and records the time taken.
+///
+/// This method must be called on the queue of the writer context.
+- (BOOL)_writeToStore:(NSError **)error {
+	if(!_writerContext.hasChanges) {
+		return YES;
+	}
+	CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+	BOOL saved = [_writerContext save:error];
+	recordSaveDuration(&storeWriteStatistics, CFAbsoluteTimeGetCurrent() - start, @"Writing the database");
+	return saved;
+}
+
+
+/// Writes the changes of the writer context to the store asynchronously.
+///
+/// Saves of the view context that occur while the writer context is writing are written by the next block, hence in a single write.
+- (void)writeToStoreInBackground {
+	NSManagedObjectContext *writerContext = _writerContext;
+	[writerContext performBlock:^{
+		NSError *error;
+		if(![self _writeToStore:&error]) {
+			/// The view context has already validated the changes, so this error is unexpected (e.g., a disk error).
+			/// The changes remain in the writer context, and the next save tries writing them again.
+			NSLog(@"Failed to write the database: %@", error);
+			dispatch_async(dispatch_get_main_queue(), ^{
+				[MainWindowController.sharedController populateErrorLogWithError:error];
+				[NSApp presentError:[NSError errorWithDescription:@"Sorry. The database could not be written to disk." suggestion:@"Changes will be written again at the next save."]];
+			});
+		}
+	}];
+}
+
+
+- (BOOL)writeSavedChangesToStore:(NSError **)error {
+	NSManagedObjectContext *writerContext = _writerContext;
+	if(!writerContext) {
+		return YES;
+	}
+	__block BOOL written = YES;
+	__block NSError *writeError;
+	/// As the queue of the writer context is serial, this returns after any write that is in progress.
+	[writerContext performBlockAndWait:^{
+		written = [self _writeToStore:&writeError];
+	}];
+	if(!written) {
+		NSLog(@"Failed to write the database: %@", writeError);
+		if(error) {
+			*error = writeError;
+		}
+	}
+	return written;
+}
+
+
 +(void)recoverFromErrorInContext:(NSManagedObjectContext *) context showLog:(BOOL)showLog {
 	[context trySavingWithUndo];
 	
@@ -612,7 +937,7 @@ CaseSensitiveSampleSearch = @"CaseSensitiveSampleSearch";
     
 	
     NSError *error = nil;
-    if (context.hasChanges && ![context save:&error]) {
+    if (context.hasChanges && ![self saveContext:context error:&error]) {
 		NSString *log = [MainWindowController.sharedController populateErrorLogWithError:error];
 	
         NSString *question = @"Sorry, the database could not be saved before quitting because of an inconsistency in the data. Quit anyway?";
@@ -633,6 +958,20 @@ CaseSensitiveSampleSearch = @"CaseSensitiveSampleSearch";
         }
     }
 	
+	/// Saved changes must be written to the store before we quit, and before the trash is emptied.
+	if(![self writeSavedChangesToStore:&error]) {
+		[MainWindowController.sharedController populateErrorLogWithError:error];
+		NSAlert *alert = NSAlert.new;
+		alert.messageText = @"Sorry, the database could not be written to disk before quitting. Quit anyway?";
+		alert.informativeText = @"Quitting now will lose any changes made since the last save.";
+		[alert addButtonWithTitle:@"Quit anyway"];
+		[alert addButtonWithTitle:@"Cancel"];
+		if([alert runModal] == NSAlertSecondButtonReturn) {
+			return NSTerminateCancel;
+		}
+		return NSTerminateNow;
+	}
+	
 	if(quitWithoutCleaning) {
 		return NSTerminateNow;
 	}
@@ -697,6 +1036,7 @@ CaseSensitiveSampleSearch = @"CaseSensitiveSampleSearch";
 		/// We therefore cancel the termination, otherwise the app would quit in the middle of the operation
 		return NSTerminateCancel;
 	}
+	[self writeSavedChangesToStore:nil];
 	return NSTerminateNow;
 	
 }
@@ -20,6 +20,7 @@
 
 
 #import "TableViewController.h"
+@class Genotype;
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -37,6 +38,16 @@ NS_ASSUME_NONNULL_BEGIN
 /// A  key to the user default that allows access to the genotype filters applied to folders
 extern UserDefaultKey GenotypeFiltersKey;
 
+/// Calls the alleles of genotypes using ``Genotype/callAllelesOfGenotypes:annotateAdditionalPeaks:progress:completionHandler:``,
+/// showing a progress window that allows cancelling the operation.
+///
+/// The modifications are registered in a single undo action and saved.
+/// - Parameters:
+///   - genotypes: The genotypes whose alleles should be called.
+///   - annotateSuppPeaks: Whether additional peaks should be annotated.
+///   - actionName: The name of the undo action.
+- (void)callAllelesOfGenotypes:(NSArray<Genotype *> *)genotypes annotateAdditionalPeaks:(BOOL)annotateSuppPeaks actionName:(NSString *)actionName;
+
 
 
 @end
@@ -31,6 +31,7 @@
 #import "AggregatePredicateEditorRowTemplate.h"
 #import "Allele.h"
 #import "MarkerTableController.h"
+#import "ProgressWindow.h"
 
 @interface GenotypeTableController ()
 
@@ -239,13 +240,13 @@
 - (NSArray *)validTargetsOfSender:(id)sender {
 	NSArray *targetGenotypes = [super validTargetsOfSender:sender];
 	BOOL fromContextMenu = [sender respondsToSelector:@selector(topMenu)] && [sender topMenu] == self.tableView.menu;
-	if([sender action] == @selector(binAlleles:) || [sender action] == @selector(callAlleles:)) {
+	if([sender action] == @selector(binAlleles:) || [sender action] == @selector(callAlleles:) || [sender action] == @selector(estimateOffsets:)) {
 		if(!fromContextMenu) {
 			/// If the sender is not from the table's contextual menu, its potential targets are all listed genotypes
 			targetGenotypes = self.genotypes.arrangedObjects;
 		}
 		targetGenotypes = [targetGenotypes filteredArrayUsingBlock:^BOOL(Genotype*  _Nonnull genotype, NSUInteger idx) {
-			/// We don't bin/call alleles of samples that are not sized, or genotypes that have been edited manually, except when called from the contextual menu
+			/// We don't bin/call alleles or estimate offsets of samples that are not sized, or genotypes that have been edited manually, except when called from the contextual menu
 			GenotypeStatus status = genotype.status;
 			return  status != genotypeStatusNoSizing && (fromContextMenu || status != genotypeStatusManual);
 		}];
@@ -332,24 +333,35 @@
 		}
 	}
 	
-	[AppDelegate.sharedInstance saveAction:self];
+	[AppDelegate.sharedInstance setNeedsSave];
 }
 
 
 - (IBAction)callAlleles:(id)sender {
-	/// we don't create a managed object context to call alleles as allele call is very quick (less than 1s for 10000 genotypes)
-	/// and is actually slower when we use a child context
-	[self.undoManager setActionName:@"Find Alleles"];
 	NSArray *genotypes = [self validTargetsOfSender:sender];
 	BOOL annotateSuppPeaks = [NSUserDefaults.standardUserDefaults boolForKey:AnnotateAdditionalPeaks];
+	[self callAllelesOfGenotypes:genotypes annotateAdditionalPeaks:annotateSuppPeaks actionName:@"Find Alleles"];
+}
 
-	for (Genotype *genotype in genotypes) {
-		[genotype callAllelesAndAdditionalPeak:annotateSuppPeaks];
+
+- (void)callAllelesOfGenotypes:(NSArray<Genotype *> *)genotypes annotateAdditionalPeaks:(BOOL)annotateSuppPeaks actionName:(NSString *)actionName {
+	if(genotypes.count == 0) {
+		return;
 	}
-	
-	//[self checkGenotypesForAdenylation:genotypes]; /// deactivated for now, as this may cause genotyping errors.
-	[AppDelegate.sharedInstance saveAction:self];
-	
+	NSProgress *progress = [NSProgress progressWithTotalUnitCount:genotypes.count];
+	progress.localizedDescription = @"Calling alleles…";
+	ProgressWindow *progressWindow = ProgressWindow.new;
+	[progressWindow showProgressWindowForProgress:progress afterDelay:0.5 modal:YES parentWindow:self.view.window];
+	
+	[Genotype callAllelesOfGenotypes:genotypes annotateAdditionalPeaks:annotateSuppPeaks progress:progress completionHandler:^(BOOL completed) {
+		[progressWindow stopShowingProgressAndClose];
+		if(completed) {
+			/// Alleles are all modified in the same pass of the run loop, hence in a single undo group.
+			[self.undoManager setActionName:actionName];
+			//[self checkGenotypesForAdenylation:genotypes]; /// deactivated for now, as this may cause genotyping errors.
+			[AppDelegate.sharedInstance setNeedsSave];
+		}
+	}];
 }
 
 
@@ -401,7 +413,7 @@ static NSInteger genotypeIndex = 0;
 		}
 	}
 	
-	[AppDelegate.sharedInstance saveAction:self];
+	[AppDelegate.sharedInstance setNeedsSave];
 }
 
 
@@ -419,13 +431,40 @@ static NSInteger genotypeIndex = 0;
 }
 
 
+- (IBAction)estimateOffsets:(id)sender {
+	NSArray *genotypes = [self validTargetsOfSender:sender];
+	if(genotypes.count == 0) {
+		return;
+	}
+	/// Offsets are estimated in a context that reads the store, which must reflect the current sizing of samples.
+	AppDelegate *appDelegate = AppDelegate.sharedInstance;
+	if(appDelegate.managedObjectContext.hasChanges) {
+		[appDelegate saveAction:self];
+	}
+	[appDelegate writeSavedChangesToStore:nil];
+	
+	NSProgress *progress = [NSProgress progressWithTotalUnitCount:genotypes.count];
+	progress.localizedDescription = @"Estimating offsets…";
+	ProgressWindow *progressWindow = ProgressWindow.new;
+	[progressWindow showProgressWindowForProgress:progress afterDelay:0.5 modal:YES parentWindow:self.view.window];
+	
+	[Genotype estimateOffsetsOfGenotypes:genotypes progress:progress completionHandler:^(BOOL completed) {
+		[progressWindow stopShowingProgressAndClose];
+		if(completed) {
+			[self.undoManager setActionName:@"Estimate Genotype Offsets"];
+			[AppDelegate.sharedInstance setNeedsSave];
+		}
+	}];
+}
+
+
 - (void)removeOffsets:(id)sender {
 	[self.undoManager setActionName:@"Reset Genotype Offset(s)"];
 	NSArray *genotypes = [self validTargetsOfSender:sender];
 	for(Genotype *genotype in genotypes) {
 		genotype.offsetData = nil;
 	}
-	[AppDelegate.sharedInstance saveAction:self];
+	[AppDelegate.sharedInstance setNeedsSave];
 }
 
 #pragma mark - export and copy
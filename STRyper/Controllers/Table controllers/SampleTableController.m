@@ -36,6 +36,8 @@
 #import "Genotype.h"
 #import "Allele.h"
 #import "ProgressWindow.h"
+#import "Concordance.h"
+#import "TraceSimilarity.h"
 #import "IndexImageView.h"
 #import "AggregatePredicateEditorRowTemplate.h"
 
@@ -370,10 +372,17 @@
 		if(![sampleGenotypes sharesObjectsWithArray:shownGenotypes]) {
 			return nil;
 		}
-	} else if([sender action] == @selector(callGenotypes:)) {
+	} else if([sender action] == @selector(callGenotypes:) || [sender action] == @selector(checkConcordance:)) {
 		targetSamples = [targetSamples filteredArrayUsingBlock:^BOOL(Chromatogram*  _Nonnull sample, NSUInteger idx) {
 			return  sample.sizingQuality.floatValue > 0 && sample.genotypes.count > 0;
 		}];
+	} else if([sender action] == @selector(findDuplicateSamples:)) {
+		targetSamples = [targetSamples filteredArrayUsingBlock:^BOOL(Chromatogram*  _Nonnull sample, NSUInteger idx) {
+			return  sample.sizingQuality.floatValue > 0;
+		}];
+		if(targetSamples.count < 2) {
+			return nil;
+		}
 	} else if([sender action] == @selector(showInFinder:) && targetSamples.count > 1) {
 		return nil;
 	}
@@ -589,14 +598,12 @@
 	if(order < 0) {
 		order = 0;
 	}
-	if(order > 2) {
-		order = 2;
+	if(order > NaturalCubicSpline) {
+		order = NaturalCubicSpline;
 	}
 	[self.undoManager setActionName:@"Apply Fitting Method"];
-	for(Chromatogram *sample in [self validTargetsOfSender:sender]) {
-		sample.polynomialOrder = order;
-	}
-	[AppDelegate.sharedInstance saveAction:self];
+	[Chromatogram setPolynomialOrder:order forSamples:[self validTargetsOfSender:sender]];
+	[AppDelegate.sharedInstance setNeedsSave];
 }
 
 
@@ -621,14 +628,174 @@
 	BOOL annotateSuppPeaks = [NSUserDefaults.standardUserDefaults boolForKey:AnnotateAdditionalPeaks];
 	
 	NSArray *samples =[self validTargetsOfSender:sender];
-	[self.undoManager setActionName:@"Call Genotypes"];
+	NSMutableArray *genotypes = NSMutableArray.new;
 	for(Chromatogram *sample in samples) {
-		for (Genotype *genotype in sample.genotypes) {
-			[genotype callAllelesAndAdditionalPeak:annotateSuppPeaks];
+		[genotypes addObjectsFromArray:sample.genotypes.allObjects];
+	}
+	[GenotypeTableController.sharedController callAllelesOfGenotypes:genotypes annotateAdditionalPeaks:annotateSuppPeaks actionName:@"Call Genotypes"];
+}
+
+
+/// Compares the genotypes of target samples that share a key chosen by the user, and saves a report of mismatches.
+- (IBAction)checkConcordance:(id)sender {
+	NSArray<Chromatogram *> *samples = [self validTargetsOfSender:sender];
+	if(samples.count < 2) {
+		return;
+	}
+	
+	/// The accessory view lets the user choose the sample attribute whose values define groups of samples to compare.
+	NSPopUpButton *keyPopup = [[NSPopUpButton alloc] initWithFrame:NSMakeRect(0, 30, 300, 25) pullsDown:NO];
+	NSArray *titles = @[@"Sample Name", @"Pattern in Sample Name", @"Sample Type", @"Owner", @"Comment", @"Results Group"];
+	NSArray *keyPaths = @[@"sampleName", @"sampleName", @"sampleType", @"owner", @"comment", @"resultsGroup"];
+	[keyPopup addItemsWithTitles:titles];
+	NSTextField *patternField = [[NSTextField alloc] initWithFrame:NSMakeRect(0, 0, 300, 22)];
+	patternField.placeholderString = @"Regular expression, e.g. ^(.+)_rep[0-9]+$";
+	NSView *accessoryView = [[NSView alloc] initWithFrame:NSMakeRect(0, 0, 300, 55)];
+	[accessoryView addSubview:keyPopup];
+	[accessoryView addSubview:patternField];
+	
+	NSAlert *alert = NSAlert.new;
+	alert.messageText = @"Compare genotypes of samples sharing:";
+	alert.informativeText = @"With a pattern, samples are grouped by the first capture group of the regular expression in their name, or by the matched text if there is no group.";
+	alert.accessoryView = accessoryView;
+	[alert addButtonWithTitle:@"Compare"];
+	[alert addButtonWithTitle:@"Cancel"];
+	
+	[alert beginSheetModalForWindow:self.view.window completionHandler:^(NSModalResponse returnCode) {
+		if(returnCode != NSAlertFirstButtonReturn) {
+			return;
 		}
+		NSInteger index = keyPopup.indexOfSelectedItem;
+		NSString *keyPath = keyPaths[index];
+		NSRegularExpression *regex;
+		if(index == 1) {
+			NSError *error;
+			regex = [NSRegularExpression regularExpressionWithPattern:patternField.stringValue options:0 error:&error];
+			if(!regex) {
+				[[NSAlert alertWithError:[NSError errorWithDescription:@"The pattern is not a valid regular expression."
+															suggestion:error.localizedDescription ?: @""]] runModal];
+				return;
+			}
+		}
+		
+		NSString *(^keyForSample)(Chromatogram *) = ^NSString *(Chromatogram *sample) {
+			NSString *value = [sample valueForKeyPath:keyPath];
+			if(!regex || value.length == 0) {
+				return value;
+			}
+			NSTextCheckingResult *match = [regex firstMatchInString:value options:0 range:NSMakeRange(0, value.length)];
+			if(!match) {
+				return nil;
+			}
+			NSRange range = match.numberOfRanges > 1? [match rangeAtIndex:1] : match.range;
+			return range.location == NSNotFound? nil : [value substringWithRange:range];
+		};
+		
+		[self saveReportForSamples:samples prefetchingKeyPaths:@[ChromatogramGenotypesKey, @"genotypes.alleles", @"genotypes.marker"]
+			   progressDescription:@"Comparing genotypes…"
+					   reportBlock:^NSString *(NSArray<Chromatogram *> *backgroundSamples, NSProgress *progress) {
+			return concordanceReportForSamples(backgroundSamples, keyForSample, progress);
+		} panelMessage:@"Save concordance report" fileNameSuffix:@" concordance.txt"];
+	}];
+}
+
+
+/// Computes a report on samples in a background context while showing a progress window, then lets the user save the report to a text file.
+///
+/// The context of samples is saved and written to the store beforehand, so that the background context sees their current state.
+/// - Parameters:
+///   - samples: The samples on which the report is made.
+///   - keyPaths: The relationship key paths to prefetch with samples in the background context.
+///   - description: The description of the progress shown in the progress window.
+///   - reportBlock: A block that returns the report, which is called on the queue of the background context with the samples of this context.
+///   The block should update the progress, and return `nil` if the progress is cancelled.
+///   - message: The message of the save panel.
+///   - suffix: The end of the default file name, which starts with the name of the selected folder.
+- (void)saveReportForSamples:(NSArray<Chromatogram *> *)samples prefetchingKeyPaths:(NSArray<NSString *> *)keyPaths
+		 progressDescription:(NSString *)description
+				 reportBlock:(NSString *_Nullable (^)(NSArray<Chromatogram *> *backgroundSamples, NSProgress *progress))reportBlock
+				panelMessage:(NSString *)message fileNameSuffix:(NSString *)suffix {
+	if(samples.firstObject.managedObjectContext.hasChanges) {
+		[AppDelegate.sharedInstance saveAction:self];
+	}
+	[AppDelegate.sharedInstance writeSavedChangesToStore:nil];
+	NSArray<NSManagedObjectID *> *sampleIDs = [samples valueForKeyPath:@"@unionOfObjects.objectID"];
+	NSProgress *progress = [NSProgress progressWithTotalUnitCount:sampleIDs.count];
+	progress.localizedDescription = description;
+	ProgressWindow *progressWindow = ProgressWindow.new;
+	NSWindow *window = self.view.window;
+	[progressWindow showProgressWindowForProgress:progress afterDelay:0.5 modal:YES parentWindow:window];
+	
+	NSManagedObjectContext *backgroundContext = AppDelegate.sharedInstance.persistentContainer.newBackgroundContext;
+	[backgroundContext performBlock:^{
+		NSError *error;
+		NSString *report;
+		NSArray *backgroundSamples = [Chromatogram samplesWithIDs:sampleIDs inContext:backgroundContext prefetchingKeyPaths:keyPaths error:&error];
+		if(backgroundSamples) {
+			report = reportBlock(backgroundSamples, progress);
+		}
+		/// The objects are no longer needed.
+		[backgroundContext reset];
+		
+		dispatch_async(dispatch_get_main_queue(), ^{
+			[progressWindow stopShowingProgressAndClose];
+			if(error) {
+				[NSApp presentError:error];
+				return;
+			}
+			if(!report) {
+				return;
+			}
+			NSSavePanel* panel = NSSavePanel.savePanel;
+			panel.message = message;
+			panel.nameFieldStringValue = [FolderListController.sharedController.selectedFolder.name stringByAppendingString:suffix];
+			panel.allowedFileTypes = @[@"public.plain-text"];
+			[panel beginSheetModalForWindow:window completionHandler:^(NSInteger result){
+				if (result == NSModalResponseOK) {
+					NSError *error = nil;
+					[report writeToURL:panel.URL atomically:YES encoding:NSUTF8StringEncoding error:&error];
+					if(error) {
+						[NSApp presentError:error];
+					}
+				}
+			}];
+		});
+	}];
+}
+
+
+/// Finds target samples whose peaks are similar enough for them to be duplicates, and saves a report of these samples.
+- (IBAction)findDuplicateSamples:(id)sender {
+	NSArray<Chromatogram *> *samples = [self validTargetsOfSender:sender];
+	if(samples.count < 2) {
+		return;
 	}
-	[AppDelegate.sharedInstance saveAction:self];
 	
+	NSTextField *similarityField = [[NSTextField alloc] initWithFrame:NSMakeRect(0, 0, 60, 22)];
+	similarityField.floatValue = 0.6;
+	NSAlert *alert = NSAlert.new;
+	alert.messageText = @"Minimum similarity between samples:";
+	alert.informativeText = @"The similarity is the fraction of peaks that two samples share. Samples whose peaks are mostly found in another sample are also reported, as they may be contaminated.";
+	alert.accessoryView = similarityField;
+	[alert addButtonWithTitle:@"Find"];
+	[alert addButtonWithTitle:@"Cancel"];
+	
+	[alert beginSheetModalForWindow:self.view.window completionHandler:^(NSModalResponse returnCode) {
+		if(returnCode != NSAlertFirstButtonReturn) {
+			return;
+		}
+		float minSimilarity = similarityField.floatValue;
+		if(minSimilarity <= 0 || minSimilarity > 1) {
+			[[NSAlert alertWithError:[NSError errorWithDescription:@"The minimum similarity must be between 0 and 1."
+														suggestion:@""]] runModal];
+			return;
+		}
+		[self saveReportForSamples:samples prefetchingKeyPaths:@[ChromatogramTracesKey]
+			   progressDescription:@"Reading peaks of samples…"
+					   reportBlock:^NSString *(NSArray<Chromatogram *> *backgroundSamples, NSProgress *progress) {
+			return similarityReportForSamples(backgroundSamples, minSimilarity, progress);
+		} panelMessage:@"Save report of similar samples" fileNameSuffix:@" similar samples.txt"];
+	}];
 }
 
 
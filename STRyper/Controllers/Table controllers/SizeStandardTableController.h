@@ -38,6 +38,11 @@ NS_ASSUME_NONNULL_BEGIN
 
 /// Applies a size standard to samples (Chromatogram objects).
 ///
+/// Samples are sized on background threads using background contexts of the persistent container, while a modal progress window allows the user to cancel the operation.
+/// Their changes are saved to the store and merged into the view context, hence they are not registered by the undo manager.
+/// Instead, undoing the action restores previous size standards and sizes samples again with them.
+/// If the operation is cancelled or fails, the action is undone so that no sample remains partially processed.
+///
 /// - Parameters:
 ///   - standard: The size standard to apply.
 ///   - sampleArray: The  samples that `standard` should be applied to.
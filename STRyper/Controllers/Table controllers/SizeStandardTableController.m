@@ -25,6 +25,7 @@
 #import "SizeStandardSize.h"
 #import "SampleTableController.h"
 #import "ProgressWindow.h"
+#import "MainWindowController.h"
 
 @class SizeTableController;
 
@@ -200,52 +201,154 @@ NSPasteboardType _Nonnull const SizeStandardDragType = @"org.jpeccoud.stryper.si
 
 - (void)applySizeStandard:(SizeStandard*) standard toSamples:(NSArray <Chromatogram *> *)sampleArray {
 	NSManagedObjectContext *MOC = sampleArray.firstObject.managedObjectContext;
-	if(!MOC) {
+	if(!MOC || standard.managedObjectContext != MOC) {
 		return;
 	}
-	/// We  show progress but don't use a background context because materializing all samples in this context woud take a long time.
-	/// So we progress in batches on the view context between which we update the UI via a progress window.
-	NSInteger batchSize = 30;
-	NSInteger sampleCount = sampleArray.count;
-	NSProgress *progress = [NSProgress progressWithTotalUnitCount:sampleCount];
+	
 	NSUndoManager *undoManager = MOC.undoManager;
 	[undoManager setActionName:@"Apply Size Standard"];
 	[undoManager beginUndoGrouping];
+	/// Sizing changes reach the view context by merges, which the undo manager does not register.
+	/// Undoing the action therefore sizes the samples again, after their previous size standard is restored.
+	[self registerSizingUndoForSamples:sampleArray undoManager:undoManager];
+	
+	/// The relationship with the size standard is set in the view context, which is quick.
+	/// This way, worker contexts don't modify the `samples` relationship of the size standard concurrently.
+	for(Chromatogram *sample in sampleArray) {
+		sample.sizeStandard = standard;
+	}
+	[MOC processPendingChanges];
+	[undoManager endUndoGrouping];
+	
+	[self sizeSamplesInBackground:sampleArray completionHandler:^(BOOL completed) {
+		if(!completed && undoManager.canUndo) {
+			/// Cancellation leaves no partially sized selection: we undo the action, which restores and reapplies previous size standards.
+			[undoManager undo];
+		}
+	}];
+}
+
+
+/// Registers an undo action that sizes samples with the size standard they have after undo or redo.
+///
+/// The action registers itself again, so that redo sizes samples with the size standard that redo restores.
+- (void)registerSizingUndoForSamples:(NSArray<Chromatogram *> *)sampleArray undoManager:(NSUndoManager *)undoManager {
+	[undoManager registerUndoWithTarget:self handler:^(SizeStandardTableController *target) {
+		[target registerSizingUndoForSamples:sampleArray undoManager:undoManager];
+		/// Size standards are restored by other actions of the undo group, and sizing saves the view context, which must not occur during undo.
+		dispatch_async(dispatch_get_main_queue(), ^{
+			[target sizeSamplesInBackground:sampleArray completionHandler:nil];
+		});
+	}];
+}
+
+
+/// Sizes samples with their size standard, using background contexts of the persistent container, while a modal progress window allows the user to cancel the operation.
+///
+/// Samples that have no size standard get default sizing coefficients.
+/// The view context is saved and written to the store beforehand, so that workers read the current size standard of samples.
+/// Workers save their context in batches, which writes changes to the store. The application delegate then merges these changes into the view context.
+/// - Parameters:
+///   - sampleArray: Samples of the view context.
+///   - completionHandler: Block called on the main queue when sizing is over, with `completed` being `NO` if sizing was cancelled or failed.
+- (void)sizeSamplesInBackground:(NSArray<Chromatogram *> *)sampleArray completionHandler:(nullable void (^)(BOOL completed))completionHandler {
+	AppDelegate *appDelegate = AppDelegate.sharedInstance;
+	NSManagedObjectContext *MOC = appDelegate.managedObjectContext;
+	sampleArray = [sampleArray filteredArrayUsingPredicate:[NSPredicate predicateWithBlock:^BOOL(Chromatogram *sample, NSDictionary *bindings) {
+		return sample.managedObjectContext == MOC && !sample.isDeleted;
+	}]];
+	
+	NSInteger sampleCount = sampleArray.count;
+	if(sampleCount == 0) {
+		if(completionHandler) {
+			completionHandler(YES);
+		}
+		return;
+	}
+	
+	if(MOC.hasChanges) {
+		[appDelegate saveAction:self];
+	}
+	NSError *writeError;
+	if(MOC.hasChanges || ![appDelegate writeSavedChangesToStore:&writeError]) {
+		/// A failed save of the view context is reported by `saveAction:`.
+		if(writeError) {
+			[MainWindowController.sharedController populateErrorLogWithError:writeError];
+			[MainWindowController.sharedController showAlertForError:[NSError errorWithDescription:@"The size standard could not be applied because the database could not be written to disk." suggestion:@""]];
+		}
+		if(completionHandler) {
+			completionHandler(NO);
+		}
+		return;
+	}
+	
+	NSArray<NSManagedObjectID *> *sampleIDs = [sampleArray valueForKeyPath:@"@unionOfObjects.objectID"];
+	const NSInteger minSamplesPerWorker = 20;
+	NSInteger nWorkers = MAX(1, MIN(NSProcessInfo.processInfo.activeProcessorCount, sampleCount/minSamplesPerWorker));
+	/// We save about 10 times per worker, to update the view context regularly without saving too often.
+	NSInteger batchSize = MAX(10, MIN(100, sampleCount/(nWorkers*10)));
 	
+	NSProgress *progress = [NSProgress progressWithTotalUnitCount:sampleCount];
+	progress.localizedDescription = @"Sizing samples…";
 	ProgressWindow *progressWindow = ProgressWindow.new;
 	[progressWindow showProgressWindowForProgress:progress afterDelay:0.2 modal:YES parentWindow:self.view.window];
-	__block NSInteger samplesProcessed = 0;
 	
-	__block void (^processNextBatch)(void); /// The block that processes a batch of samples.
-	void (^heapBlock)(void) = ^{  /// We will launch processing of  the next batch within the current batch. To avoid block self-reference, we use another block.
-		NSInteger max = samplesProcessed+batchSize;
-		for (NSInteger i = samplesProcessed; i < max; i++) {
-			if (progress.isCancelled || i >= sampleCount) {
-				[AppDelegate.sharedInstance saveAction:self];
-				[undoManager endUndoGrouping];
-				[progressWindow stopShowingProgressAndClose];
-				return;
+	__block NSError *saveError;
+	dispatch_group_t group = dispatch_group_create();
+	for (NSInteger worker = 0; worker < nWorkers; worker++) {
+		NSManagedObjectContext *workerContext = appDelegate.persistentContainer.newBackgroundContext;
+		workerContext.undoManager = nil;
+		/// Workers only change sizing attributes, which must not override other changes saved meanwhile.
+		workerContext.mergePolicy = NSMergeByPropertyObjectTrumpMergePolicy;
+		dispatch_group_enter(group);
+		[workerContext performBlock:^{
+			NSInteger samplesInBatch = 0;
+			/// Workers process interleaved samples, so that they tend to finish at the same time.
+			for (NSInteger i = worker; i < sampleCount && !progress.isCancelled; i += nWorkers) {
+				@autoreleasepool {
+					Chromatogram *sample = [workerContext existingObjectWithID:sampleIDs[i] error:nil];
+					if(sample.sizeStandard) {
+						[sample sizeWithSizeStandard];
+					} else {
+						[sample setLinearCoefsForReadLength:DefaultReadLength];
+					}
+					samplesInBatch++;
+					if(samplesInBatch == batchSize || i + nWorkers >= sampleCount) {
+						NSError *error;
+						if(![workerContext save:&error]) {
+							@synchronized (progress) {
+								saveError = error;
+							}
+							[progress cancel];
+							break;
+						}
+						[workerContext reset];
+						@synchronized (progress) {
+							progress.completedUnitCount += samplesInBatch;
+						}
+						samplesInBatch = 0;
+					}
+				}
 			}
-			Chromatogram *sample = sampleArray[i];
-			sample.appliedSizeStandard = standard;
-			samplesProcessed++;
-		}
-		/// We schedule the next batch after a short delay to let UI update.
-		progress.completedUnitCount = samplesProcessed;
-		dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.001  * NSEC_PER_SEC)),
-					dispatch_get_main_queue(), ^{
-						if (processNextBatch) processNextBatch();
-					});
-	};
+			dispatch_group_leave(group);
+		}];
+	}
 	
-	processNextBatch = heapBlock;
-	processNextBatch(); /// We launch the first batch.
+	/// Merges of saved changes are dispatched to the main queue during saves, hence before this block.
+	dispatch_group_notify(group, dispatch_get_main_queue(), ^{
+		[progressWindow stopShowingProgressAndClose];
+		if(saveError) {
+			NSLog(@"Failed to size samples: %@", saveError);
+			[MainWindowController.sharedController showAlertForError:[NSError errorWithDescription:@"The size standard could not be applied because of an inconsistency in the data." suggestion:@""]];
+		}
+		if(completionHandler) {
+			completionHandler(!progress.isCancelled);
+		}
+	});
 }
 
 
 
-
-
 -(void) detectAndApplySizeStandardOnSample:(Chromatogram *)sample {
 	NSString *standardName = sample.standardName;
 	if(standardName.length < 3) {
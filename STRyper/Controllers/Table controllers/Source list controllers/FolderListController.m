@@ -172,6 +172,13 @@
 
 -(void)setSelectedFolder:(Folder *)selectedFolder {
 
+	/// The sample and genotype tables, which observe this property, would otherwise fault related objects one by one.
+	if([selectedFolder respondsToSelector:@selector(samples)]) {
+		NSSet *samples = ((SampleFolder *)selectedFolder).samples;
+		if(samples) {
+			[Chromatogram prefetchTableContentForSamples:samples];
+		}
+	}
 	_selectedFolder = selectedFolder;
 	self.canImportSamples = selectedFolder != nil && !selectedFolder.isSmartFolder && selectedFolder != self.rootFolder && selectedFolder != self.trashFolder;
 	
@@ -630,7 +637,7 @@
 					error = [NSError errorWithDescription:@"You do not have permission to export the folder at the specified destination." suggestion:@"Choose another destination or change its permissions."];
 				}
 				
-				/// we must save the context before export (as the folder will be materialized in another context)
+				/// we must save the context before export (as the folder will be materialized in another context, which reads the store)
 				BOOL saveError = NO;
 				if(folder.managedObjectContext.hasChanges) {
 					saveError = ![folder.managedObjectContext save:&error];
@@ -640,6 +647,9 @@
 						error = [NSError errorWithDescription:@"The folder could not be exported because of an inconsistency in the database." suggestion:@"Recent changes will be undone to solve this inconsistency."];
 					}
 				}
+				if(!error && ![AppDelegate.sharedInstance writeSavedChangesToStore:nil]) {
+					error = [NSError errorWithDescription:@"The folder could not be exported because the database could not be written to disk." suggestion:@""];
+				}
 				
 				if(error) {
 					[NSApp presentError:error];
@@ -764,8 +774,16 @@
 -(void)emptyTrashWithCompletionHandler:(void (^)(NSError * _Nullable error))callbackBlock {
 	SampleFolder *trashFolder = self.trashFolder;
 	if(trashFolder.subfolders.count > 0 || trashFolder.samples.count > 0) {
+		/// Samples are deleted directly in the store, which must therefore reflect the content of the trash.
+		NSManagedObjectContext *viewContext = trashFolder.managedObjectContext;
+		AppDelegate *appDelegate = AppDelegate.sharedInstance;
+		if(viewContext.hasChanges) {
+			[appDelegate saveAction:self];
+		}
+		[appDelegate writeSavedChangesToStore:nil];
+		NSManagedObjectContext *writerContext = appDelegate.writerContext;
 		/// We delete the trash content it in the background to show a process window, in case deletion takes time (lots of items in the trash)
-		NSManagedObjectContext *backgroundContext = AppDelegate.sharedInstance.persistentContainer.newBackgroundContext;
+		NSManagedObjectContext *backgroundContext = appDelegate.persistentContainer.newBackgroundContext;
 		ProgressWindow *progressWindow = ProgressWindow.new;
 		NSWindow *window = self.view.window;
 		NSOperationQueue *callingQueue = NSOperationQueue.currentQueue;
@@ -773,41 +791,41 @@
 			NSError *error;
 			SampleFolder *trash = [backgroundContext existingObjectWithID:trashFolder.objectID error:&error];
 			if(!error) {
-				/// We delete samples before deleting folders, which allows better granularity in progress tracking
-				/// and in saving to the store (avoids a big memory spike that would occur if we saved after deleting a folder with many files).
-				NSSet *allSamples = trash.allSamples;
-				NSUInteger samplesToDelete = allSamples.count;
-				NSProgress *progress = [NSProgress progressWithTotalUnitCount:samplesToDelete];
-				progress.cancellable = NO;
-				progress.localizedDescription = @"Cleaning the database…";
-				[progress becomeCurrentWithPendingUnitCount:1];
-				[progressWindow showProgressWindowForProgress:progress afterDelay:0.5 modal:YES parentWindow:window];
-				NSUInteger nDeleteSamples = 0, nDeletedSamplesInBatch = 0, reportCount = samplesToDelete/100 +1;
-				for(Chromatogram *sample in allSamples) {
-					[backgroundContext deleteObject:sample];
-					nDeleteSamples++;
-					nDeletedSamplesInBatch++;
-					if(nDeleteSamples % reportCount == 0) {
-						progress.completedUnitCount = nDeleteSamples;
-					}
-					if(nDeletedSamplesInBatch == 100 || nDeleteSamples == samplesToDelete) {
-						nDeletedSamplesInBatch = 0;
-						if(![backgroundContext save:&error]) {
-							break;
+				/// We delete samples by batches of object IDs, before deleting folders.
+				/// This avoids loading samples, their traces, genotypes and alleles in memory, which would take minutes for large folders.
+				NSMutableSet *folders = [NSMutableSet setWithObject:trash];
+				NSSet *subfolders = trash.allSubfolders;
+				if(subfolders) {
+					[folders unionSet:subfolders];
+				}
+				NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:Chromatogram.entity.name];
+				request.predicate = [NSPredicate predicateWithFormat:@"folder IN %@", folders];
+				request.resultType = NSManagedObjectIDResultType;
+				NSArray<NSManagedObjectID *> *sampleIDs = [backgroundContext executeFetchRequest:request error:&error];
+				if(sampleIDs) {
+					NSProgress *progress = [NSProgress progressWithTotalUnitCount:sampleIDs.count];
+					progress.cancellable = NO;
+					progress.localizedDescription = @"Cleaning the database…";
+					[progressWindow showProgressWindowForProgress:progress afterDelay:0.5 modal:YES parentWindow:window];
+					CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+					if([Chromatogram deleteSamplesWithIDs:sampleIDs inContext:backgroundContext
+							   mergingChangesIntoContexts:@[backgroundContext, writerContext, viewContext] progress:progress error:&error]) {
+						if(sampleIDs.count > 0) {
+							NSLog(@"Deleted %ld samples in %.1f s.", sampleIDs.count, CFAbsoluteTimeGetCurrent() - startTime);
+						}
+						for(Folder *folder in trash.subfolders) {
+							[backgroundContext deleteObject:folder];
+						}
+						if(backgroundContext.hasChanges) {
+							[backgroundContext save:&error];
 						}
 					}
 				}
-				for(Folder *folder in trash.subfolders) {
-					[backgroundContext deleteObject:folder];
-				}
-
-				if(backgroundContext.hasChanges) {
-					[backgroundContext save:&error];
-				}
-				[progress resignCurrent];
 			}
 			[progressWindow stopShowingProgressAndClose];
 			[callingQueue addOperationWithBlock:^{
+				/// Actions that could be undone may involve deleted objects.
+				[viewContext.undoManager removeAllActions];
 				callbackBlock(error);
 			}];
 		}];
@@ -641,7 +641,7 @@ NSBindingName const ContentArrayBinding = @"contentArray";
 	
 	[self.undoManager setActionName:actionName];
 	[self deleteItems:items];
-	[AppDelegate.sharedInstance saveAction:self];
+	[AppDelegate.sharedInstance setNeedsSave];
 	
 }
 
@@ -668,7 +668,7 @@ NSBindingName const ContentArrayBinding = @"contentArray";
 			[item.managedObjectContext deleteObject:item];
 		}
 	}
-	[AppDelegate.sharedInstance saveAction:self];
+	[AppDelegate.sharedInstance setNeedsSave];
 }
 
 
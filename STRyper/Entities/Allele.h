@@ -82,6 +82,16 @@ NS_ASSUME_NONNULL_BEGIN
 /// If no bin is found, the "out of bin" allele name is set.
 -(void)findNameFromBins;
 
+/// Assigns the allele to a peak of known size, then names it with ``findNameFromBins``.
+///
+/// This method is used when alleles are called. Contrary to setting the ``LadderFragment/scan``, it does not make the allele compute its ``size``.
+/// It only sets the attributes whose value changes, so that an allele taking the same peak is not marked as updated
+/// and does not generate undo actions, change notifications or writes to the store.
+/// - Parameters:
+///   - scan: The scan of the tip of the peak.
+///   - size: The size of the peak in base pairs, considering the ``Genotype/offset`` of the ``genotype``.
+-(void)takePeakAtScan:(int32_t)scan size:(float)size;
+
 /// Convenience method to delete an allele considered as ``LadderFragment/additional``.
 ///
 /// The method removes the receiver from its ``genotype`` and ``LadderFragment/trace`` and deletes it form its managed object context.
@@ -84,83 +84,61 @@
 	return self;
 }
 
-static NSArray<NSString *> *observedAttributes;
-static void *attributeChangeContext = &attributeChangeContext;
+/// The attributes whose changes require the genotype to update the alleles it shows.
+static NSSet<NSString *> *attributesAffectingGenotype;
 
 + (void)initialize {
 	if (self == [Allele class]) {
-		observedAttributes = @[@"genotype", @"size", @"name", @"scan"];
-	}
-}
-
-- (void)awakeFromFetch {
-	[super awakeFromFetch];
-	if(self.managedObjectContext.concurrencyType == NSMainQueueConcurrencyType) {
-		[self observeAttributes];
-	}
-}
-
-
-- (void)awakeFromInsert {
-	[super awakeFromInsert];
-	if(self.managedObjectContext.concurrencyType == NSMainQueueConcurrencyType) {
-		[self observeAttributes];
+		attributesAffectingGenotype = [NSSet setWithArray:@[@"genotype", @"size", @"name", @"scan"]];
 	}
 }
 
 
--(void) observeAttributes {
-	for(NSString *attribute in observedAttributes) {
-		[self addObserver:self forKeyPath:attribute options:NSKeyValueObservingOptionNew context:attributeChangeContext];
-	}
-}
-
-
-- (void)observeValueForKeyPath:(NSString *)keyPath ofObject:(id)object change:(NSDictionary *)change context:(void *)context {
-	if (context == attributeChangeContext) {
+- (void)didChangeValueForKey:(NSString *)key {
+	[super didChangeValueForKey:key];
+	/// This is also called when attributes change by undo or by merging changes from another context.
+	/// We don't register the allele as an observer of its attributes, which would be costly for many alleles.
+	if([attributesAffectingGenotype containsObject:key] && self.managedObjectContext.concurrencyType == NSMainQueueConcurrencyType) {
 		[self.genotype _alleleAttributeDidChange];
-	} else {
-		[super observeValueForKeyPath:keyPath ofObject:object change:change context:context];
 	}
 }
 
 
-- (void)willTurnIntoFault {
-	[super willTurnIntoFault];
-	@try {
-		for(NSString *attribute in observedAttributes) {
-			[self removeObserver:self forKeyPath:attribute];
-		}
-	 } @catch (NSException *exception) {
-		 // If observer wasn’t added, ignore exception
-	 }
-}
-
-
 -(void)findNameFromBins {
 	if(self.scan <= 0) {
 		return;
 	}
-	NSSet *bins = self.genotype.marker.bins;
-	if(bins.count == 0) {
-		/// If there is no bin, we remove the name so that the `string` property returns the size.
-		self.name = nil;
-		return;
-	}
-	
-	float size = self.size;
-	for (Bin *bin in bins) {
-		if (size >= bin.start && size <= bin.end) {
-			self.name = bin.name;
-			return;
+	Mmarker *marker = self.genotype.marker;
+	NSString *name = nil;		/// If there is no bin, we remove the name so that the `string` property returns the size.
+	if(marker.sortedBins.count > 0) {
+		Bin *bin = [marker binForSize:self.size];
+		if (bin) {
+			name = bin.name;
+		} else {
+			name = [NSUserDefaults.standardUserDefaults stringForKey:DubiousAlleleName];
+			if(!name) {
+				name = @"?";
+			}
 		}
 	}
-	NSString *name = [NSUserDefaults.standardUserDefaults stringForKey:DubiousAlleleName];
-	if(!name) {
-		name = @"?";
+	
+	/// We don't set a name that is unchanged, which would mark the allele as updated.
+	NSString *currentName = self.name;
+	if(name != currentName && ![name isEqualToString:currentName]) {
+		self.name = name;
 	}
-	self.name = name;
+}
 
+
+-(void)takePeakAtScan:(int32_t)scan size:(float)size {
+	/// We avoid the normal setter, which computes the size.
+	if(self.scan != scan) {
+		[self managedObjectOriginal_setScan:scan];
+	}
+	if(self.size != size) {
+		[self managedObjectOriginal_setSize:size];
+	}
+	[self findNameFromBins];
 }
 
 
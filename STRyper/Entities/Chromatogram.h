@@ -218,11 +218,10 @@ typedef struct OffscaleRegion {
 *dye5;
 
 
-/// Sets ``sizes`` to `nil`.
+/// Releases the reference that the receiver has to its ``sizes``.
 ///
-/// This method is intended to reduce the memory footprint of the receiver, as the ``sizes`` property
-/// is by far the one that takes the most memory.
-/// Size will be recomputed the next time ``sizes`` is sent to the receiver.
+/// The ``sizes`` array is retained by the ``SizeArrayCache``, which releases it when its byte limit is exceeded.
+/// The array will be obtained from the cache or recomputed the next time ``sizes`` is sent to the receiver.
 -(void)refreshSizeData;
 
 #pragma mark - sizing-related attributes and methods
@@ -245,6 +244,15 @@ typedef struct OffscaleRegion {
 /// For this, one may use the convenience property ``appliedSizeStandard``.
 @property (nonatomic, nullable) SizeStandard *sizeStandard;
 
+/// Sizes the sample with its ``sizeStandard``.
+///
+/// This method gives the sample the default ``polynomialOrder`` if it has none, and calls ``SizeStandard/sizeSample:``.
+/// It does nothing if the sample has no ``sizeStandard``.
+///
+/// Contrary to the setter of ``appliedSizeStandard``, this method does not modify the ``sizeStandard`` relationship, hence the ``SizeStandard/samples`` of the size standard.
+/// It can therefore be called on samples materialized in different contexts at the same time, once their ``sizeStandard`` is set in the parent context.
+-(void)sizeWithSizeStandard;
+
 /// The name of  the size standard applied to the sample, as coded in the ABIF file.
 ///
 /// This is not the same as the ``SizeStandard/name`` of the sample's ``sizeStandard``.
@@ -264,16 +272,51 @@ typedef NS_ENUM(int16_t, PolynomialOrder) {
 	
 	/// Denotes a polynomial of the third order.
 	ThirdOrderPolynomial = 2,
+	
+	/// Denotes the Local Southern method: between two adjacent ladder fragments,
+	/// the size is the average of the two second-order polynomials that pass through three consecutive fragments including these two.
+	/// Beyond the first and last fragments, sizes extend linearly.
+	LocalSouthern = 3,
+	
+	/// Denotes a natural cubic spline passing through ladder fragments.
+	/// Beyond the first and last fragments, sizes extend linearly.
+	NaturalCubicSpline = 4,
 } ;
 
 /// The order of the polynomial equation used to size the sample.
+///
+/// Values ``PolynomialOrder/LocalSouthern`` and ``PolynomialOrder/NaturalCubicSpline`` denote piecewise sizing methods, whose function is stored in ``sizingSegments``.
 @property (nonatomic) PolynomialOrder polynomialOrder;
 
+/// A segment of a piecewise function relating scan numbers (x) and sizes in base pairs (y).
+///
+/// The size at scan x is computed with the segment that has the largest `startScan` not greater than x, among ``sizingSegments``,
+/// or with the first segment if x is lower than all `startScan` values,
+/// as `coefs[0]` + `coefs[1]`d + `coefs[2]`d^2 + `coefs[3]`d^3, where d = x - `startScan`.
+typedef struct SizingSegment {
+	/// The first scan to which the segment applies.
+	float startScan;
+	
+	/// The coefficients of the cubic function of the segment.
+	float coefs[4];
+} SizingSegment;
+
 /// Coefficients (array of float) of the nth order polynomial used to derive sizes in base pairs (y) from scan numbers (x).
 ///
 /// The number of coefficients in the array corresponds to ``polynomialOrder``.
+///
+/// If the sample uses a piecewise sizing method (see ``PolynomialOrder``), these are the coefficients of the third-order polynomial fitted to the ladder fragments,
+/// and sizes are derived from ``sizingSegments`` instead.
 @property (nonatomic, readonly) NSData *coefs;
 
+/// The segments (array of `SizingSegment` structs sorted by `startScan`) of the piecewise function used to derive sizes from scan numbers,
+/// if the sample uses a piecewise sizing method (see ``PolynomialOrder``).
+///
+/// This attribute is `nil` if sizes are derived from the polynomial of ``coefs``.
+/// It is set together with ``coefs``, so that observing ``coefs`` suffices to be notified of sizing changes.
+/// The size at a given scan can be computed from these segments with ``sizeGivenSegments``.
+@property (nonatomic, readonly, nullable) NSData *sizingSegments;
+
 /// Coefficients (array of float) of the nth order polynomial used to scan numbers (x) from sizes in base pairs (y).
 /// 
 /// This attribute helps obtaining the scan number for a given size, which would otherwise require solving a cubic equation if n = 3.
@@ -305,14 +348,32 @@ extern const float DefaultReadLength;
 
 /// Computes the relationship between sizes in base pairs and scan numbers fo the sample, using its molecular ladder.
 ///
-/// This methods sets the  ``coefs``, ``reverseCoefs``, ``intercept``, and ``sizingSlope`` attributes of the receiver, using the ``FluoTrace/fragments`` of the ``ladderTrace``.
+/// This methods sets the  ``coefs``, ``sizingSegments``, ``reverseCoefs``, ``intercept``, and ``sizingSlope`` attributes of the receiver, using the ``FluoTrace/fragments`` of the ``ladderTrace``.
 ///
 /// This method fits a polynomial order based on the ``polynomialOrder`` attribute.
 /// The method also sets the ``sizingQuality`` attribute.
 ///
+/// For piecewise methods, which pass through ladder fragments, the ``reverseCoefs``, the ``LadderFragment/offset`` of ladder fragments and the ``sizingQuality``
+/// are computed with the third-order polynomial fitted to the same fragments.
+///
 ///  If the ``ladderTrace`` of the sample has less than 4 ladder ``FluoTrace/fragments``, the method calls ``setLinearCoefsForReadLength:``.
 - (void)computeFitting;
 
+/// Computes the fitting of several samples at once.
+///
+/// This method has the same effect as sending ``computeFitting`` to each sample, but fits polynomials of all samples in one pass,
+/// which is faster for many samples.
+/// - Parameter samples: The samples whose fitting should be computed.
++ (void)computeFittingForSamples:(NSArray<Chromatogram *> *)samples;
+
+/// Sets the ``polynomialOrder`` of several samples and computes their fitting at once.
+///
+/// This method has the same effect as setting the ``polynomialOrder`` of each sample, but uses ``computeFittingForSamples:``.
+/// - Parameters:
+///   - polynomialOrder: The polynomial order to set.
+///   - samples: The samples to modify.
++ (void)setPolynomialOrder:(PolynomialOrder)polynomialOrder forSamples:(NSArray<Chromatogram *> *)samples;
+
 /// Sets the ``coefs`` and  the ``reverseCoefs`` attributes using linear regression and assuming that the size at the first scan is 0, and a given read length for the sample.
 ///
 /// This method is used when less than 4 DNA fragments where characterised in the molecular ladder, hence it sets the ``sizingQuality`` to nil.
@@ -321,14 +382,29 @@ extern const float DefaultReadLength;
 
 /// The sizes in base pairs corresponding to all recorded scans.
 ///
-/// These sizes are computed thanks to the ``coefs`` attribute.
+/// These sizes are computed thanks to the ``sizingSegments`` attribute if it is set, or to the ``coefs`` otherwise.
 /// This array avoids sending ``sizeForScan:`` each time a size is obtained from a scan number.
 ///
 /// This data object is an array of float whose length corresponds to ``nScans``.
+/// It is stored in the ``SizeArrayCache/sharedCache``, hence is shared by samples having the same sizing,
+/// and may be recomputed if the cache has released it.
+/// Callers should therefore keep a reference to the returned object while they access its bytes.
+///
+/// To get sizes for a range of scans, ``getSizes:fromScan:count:`` takes less memory.
 ///
 /// This is not a core data attribute.
 @property (nonatomic, readonly) NSData *sizes;
 
+/// Gets the sizes in base pairs for a range of scans.
+///
+/// The method copies these sizes from ``sizes`` if this array is available,
+/// and computes them from the ``sizingSegments`` or ``coefs`` otherwise, without materializing the whole array.
+/// - Parameters:
+///   - sizes: On output, the sizes. This buffer must hold at least `count` floats.
+///   - firstScan: The first scan of the range.
+///   - count: The number of scans in the range.
+- (void)getSizes:(float *)sizes fromScan:(int)firstScan count:(int)count;
+
 /// The length of the sample (read) in base pairs.
 ///
 /// This is the maximum value in the array returned by ``sizes``.
@@ -357,16 +433,82 @@ extern const float DefaultReadLength;
 
 /// Returns the size in base pairs corresponding to a given scan number.
 ///
-/// This method uses the ``coefs`` attribute. If this attribute is not available, the method returns a size of -1.
+/// This method uses the ``sizingSegments`` attribute if it is set, or the ``coefs`` attribute otherwise. If no coefficients are available, the method returns a size of -1.
 /// - Parameter scan: The scan number for which the size should be derived.
 - (float)sizeForScan:(int)scan;
 
 /// Returns the scan number that is the closest to given size in base pairs, among scans for which data exists.
 ///
-/// This method uses the ``reverseCoefs`` attribute. 
+/// This method rounds the value returned by ``fractionalScanForSize:``.
 /// - Parameter size: The size for which the scan number should be derived.
 - (int)scanForSize:(float)size;
 
+/// Returns the fractional scan number corresponding to a given size in base pairs, among scans for which data exists.
+///
+/// This method finds the two consecutive scans whose ``sizes`` surround `size` by binary search between ``minScan`` and ``maxScan``, where sizes increase,
+/// and interpolates linearly between these scans.
+/// Sizes that are lower than the size at ``minScan`` yield ``minScan``, and sizes that are higher than the size at ``maxScan`` yield ``maxScan``.
+///
+/// The method returns -1 if ``sizes`` is empty.
+/// - Parameter size: The size for which the scan number should be derived.
+- (float)fractionalScanForSize:(float)size;
+
+/// Returns the value of `y` given the value of `x` assuming a relationship y = ax^0 + bx^1 + … + cx^k
+///
+/// This function uses Horner's method.
+/// - Parameters:
+///   - x: The value for which we want to compute the y value.
+///   - coefs: The coefficient of the polynomial (a, b, c... see description), such as ``coefs`` or ``reverseCoefs``.
+///   - k: The number of values in `coefs` (the order of the polynomial plus one).
+float yGivenPolynomial(float x, const float *coefs, int k);
+
+/// Computes the values of `y` for consecutive values of `x`, assuming a relationship y = ax^0 + bx^1 + … + cx^k
+///
+/// This function evaluates the polynomial on several values at once using SIMD instructions, and does not allocate memory.
+/// It is faster than calling ``yGivenPolynomial`` on each value of `x`.
+/// - Parameters:
+///   - firstX: The first value of `x`. Other values are `firstX`+1, `firstX`+2, etc.
+///   - count: The number of values to compute.
+///   - coefs: The coefficient of the polynomial (a, b, c... see description).
+///   - k: The number of values in `coefs` (the order of the polynomial plus one).
+///   - y: On output, the `count` values of `y`. This buffer must hold at least `count` floats.
+void yGivenPolynomialForRange(float firstX, int count, const float *coefs, int k, float *y);
+
+/// Returns the size at a scan given the coefficients of a sizing polynomial (see ``coefs``).
+///
+/// - Parameters:
+///   - scan: The scan number.
+///   - coefs: The polynomial coefficients, such as the ``coefs`` of a sample.
+float sizeGivenCoefs(float scan, NSData *coefs);
+
+/// Computes the sizes of consecutive scans given the coefficients of a sizing polynomial (see ``coefs``).
+///
+/// This function does not allocate memory.
+/// - Parameters:
+///   - firstScan: The first scan.
+///   - count: The number of consecutive scans for which sizes should be computed.
+///   - coefs: The polynomial coefficients, such as the ``coefs`` of a sample.
+///   - sizes: On output, the sizes. This buffer must hold at least `count` floats.
+void sizesGivenCoefsForRange(int firstScan, int count, NSData *coefs, float *sizes);
+
+/// Returns the size at a scan given the segments of a piecewise sizing function (see ``sizingSegments``).
+///
+/// The segment is found by binary search among segments, hence in a few steps.
+/// - Parameters:
+///   - scan: The scan number.
+///   - segments: The segments of the function, such as the ``sizingSegments`` of a sample.
+float sizeGivenSegments(float scan, NSData *segments);
+
+/// Computes the sizes of consecutive scans given the segments of a piecewise sizing function (see ``sizingSegments``).
+///
+/// This function does not allocate memory.
+/// - Parameters:
+///   - firstScan: The first scan.
+///   - count: The number of consecutive scans for which sizes should be computed.
+///   - segments: The segments of the function, such as the ``sizingSegments`` of a sample.
+///   - sizes: On output, the sizes. This buffer must hold at least `count` floats.
+void sizesGivenSegmentsForRange(int firstScan, int count, NSData *segments, float *sizes);
+
 
 #pragma mark - genotyping-related attributes and methods
 
@@ -390,6 +532,44 @@ extern const float DefaultReadLength;
 /// Returns the genotypes whose markers have a given ``Mmarker/channel`` among the sample's ``genotypes``.
 -(nullable NSSet <Genotype *> *)genotypesForChannel:(NSInteger)channel;
 
+/// Fetches the objects that the sample and genotype tables show for samples whose genotypes are not in memory:
+/// the samples, their ``panel``, ``sizeStandard``, ``genotypes``, and the markers and alleles of these genotypes.
+///
+/// The objects are fetched in a few queries per batch of samples, rather than in a query per object when they are faulted as table cells are drawn or sorted.
+/// The samples retain the fetched objects via their relationships.
+/// - Parameter samples: The samples, which must be materialized in the same managed object context.
++ (void)prefetchTableContentForSamples:(NSSet<Chromatogram *> *)samples;
+
+/// Fetches samples from their object IDs in a context, with objects at given relationship key paths.
+///
+/// This method can be used to analyze samples in a background context, avoiding a query per object when relationships are faulted.
+/// Samples are fetched by batches of object IDs, in the order of `sampleIDs`. Deleted samples are omitted.
+/// - Parameters:
+///   - sampleIDs: The object IDs of the samples.
+///   - context: The context in which samples are fetched. This method must be called on the thread of this context.
+///   - keyPaths: The relationship key paths to prefetch, such as `@"genotypes.alleles"`.
+///   - error: On output, any error that prevented the fetch.
++ (nullable NSArray<Chromatogram *> *)samplesWithIDs:(NSArray<NSManagedObjectID *> *)sampleIDs inContext:(NSManagedObjectContext *)context
+									prefetchingKeyPaths:(NSArray<NSString *> *)keyPaths error:(NSError **)error;
+
+/// Deletes samples with their traces, genotypes, alleles and ladder fragments directly in the persistent store, without loading them in memory.
+///
+/// Objects are deleted by batches of samples with `NSBatchDeleteRequest`, from the leaves of the object graph to the samples,
+/// so that no object refers to a deleted object. As delete rules and `-prepareForDeletion` are not applied, the method
+/// also tells the ``BlobStore`` that it needs collection.
+///
+/// This method must be called on the thread of `context`, and the samples must have no unsaved changes in the contexts that use them.
+/// - Parameters:
+///   - sampleIDs: The object IDs of the samples to delete.
+///   - context: The context used to execute the deletion.
+///   - contexts: The contexts into which deletions are merged, after each batch.
+///   - progress: A progress whose `completedUnitCount` is incremented by the number of samples deleted.
+///   - error: On output, any error that prevented the deletion.
+/// - Returns: Whether all the samples were deleted.
++ (BOOL)deleteSamplesWithIDs:(NSArray<NSManagedObjectID *> *)sampleIDs inContext:(NSManagedObjectContext *)context
+		mergingChangesIntoContexts:(NSArray<NSManagedObjectContext *> *)contexts
+						  progress:(nullable NSProgress *)progress error:(NSError **)error;
+
 
 /// Returns a dictionary representing the marker offsets of the receiver's genotypes for given markers.
 ///
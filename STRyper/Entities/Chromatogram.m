@@ -29,7 +29,11 @@
 #import "Panel.h"
 #import "Genotype.h"
 #import "Allele.h"
+#import "SizeArrayCache.h"
+#import "DataCache.h"
+#import "BlobStore.h"
 @import Accelerate;
+@import simd;
 
 
 CodingObjectKey ChromatogramSizesKey = @"sizes",
@@ -69,9 +73,6 @@ const float DefaultReadLength = 550.0;
 
 @interface Chromatogram ()
 
-@property (nonatomic) int minScan;
-@property (nonatomic) int maxScan;
-@property (nonatomic) NSData *sizes;
 
 
 /// the url of the source file (computed on demand from -sourceFile). We use it to bind to a NSPathControl value.
@@ -94,6 +95,7 @@ const float DefaultReadLength = 550.0;
 -(void)managedObjectOriginal_setPanel:(nullable Panel *)panel;
 -(void)managedObjectOriginal_setCoefs:(nullable NSData *)coefs;
 -(void)managedObjectOriginal_setReverseCoefs:(nullable NSData *)coefs;
+-(void)managedObjectOriginal_setSizingSegments:(nullable NSData *)sizingSegments;
 -(void)managedObjectOriginal_setTraces:(nullable NSSet<Trace *>*)traces;
 -(void)managedObjectOriginal_setGenotypes:(nullable NSSet<Genotype *> *)genotypes;
 -(void)managedObjectOriginal_setOffscaleRegions:(nullable NSData *)offscaleRegions;
@@ -122,11 +124,21 @@ const float DefaultReadLength = 550.0;
 
 @implementation Chromatogram {
 	NSData *previousCoefs; /// Used to determined if sizing coefficients have changed, to update the ``sizes`` attribute in this case..
+	
+	/// The data from which sizes are computed (``sizingSegments`` or ``coefs``), as returned by ``sizingData``.
+	NSData *_sizingData;
+	
+	/// Whether `_sizingData` contains the segments of a piecewise function.
+	BOOL piecewiseSizing;
+	
+	/// The array returned by ``sizes``, which is retained by the ``DataCache`` (via the ``SizeArrayCache``).
+	/// The reference is weak so that the cache can release the array when it exceeds its byte limit.
+	__weak NSData *_sizes;
 }
 
-@dynamic comment, gelType, importDate, instrument, lane, nChannels, nScans, offScaleScans, offscaleRegions, owner, panelName, plate, protocol, resultsGroup, runName, runStopTime, sampleName, sampleType, polynomialOrder, intercept, sizingSlope, sizingQuality, coefs, reverseCoefs, sourceFile, well, folder, panel, sizeStandard, standardName, traces, genotypes;
+@dynamic comment, gelType, importDate, instrument, lane, nChannels, nScans, offScaleScans, offscaleRegions, owner, panelName, plate, protocol, resultsGroup, runName, runStopTime, sampleName, sampleType, polynomialOrder, intercept, sizingSlope, sizingQuality, coefs, reverseCoefs, sizingSegments, sourceFile, well, folder, panel, sizeStandard, standardName, traces, genotypes;
 
-@synthesize sizes = _sizes, readLength = _readLength, minScan = _minScan, maxScan = _maxScan, startSize = _startSize;
+@synthesize readLength = _readLength, minScan = _minScan, maxScan = _maxScan, startSize = _startSize;
 
 
 
@@ -410,7 +422,12 @@ const float DefaultReadLength = 550.0;
 
 - (void)setAppliedSizeStandard:(SizeStandard *)sizeStandard {
 	[self managedObjectOriginal_setSizeStandard:sizeStandard];
-	if(sizeStandard) {
+	[self sizeWithSizeStandard];
+}
+
+
+- (void)sizeWithSizeStandard {
+	if(self.sizeStandard) {
 		if(self.polynomialOrder == NoFittingMethod) {
 			[self managedObjectOriginal_setPolynomialOrder: [NSUserDefaults.standardUserDefaults integerForKey:DefaultSizingOrder]];
 		}
@@ -425,136 +442,205 @@ const float DefaultReadLength = 550.0;
 
 
 - (void)computeFitting {
+	[Chromatogram computeFittingForSamples:@[self]];
+}
+
+
+/// Information used to fit the sizing of a sample, and the results of the fitting.
+typedef struct SizingFit {
+	/// The index of the first ladder fragment of the sample in the arrays of scans and sizes.
+	int firstPoint;
 	
-	Trace *trace = self.ladderTrace;
-	if(!trace) {
-		return;
-	}
+	/// The number of ladder fragments that have a scan (points used for the fitting).
+	int nPoints;
 	
-	/// To size the sample, we fit a polynomial where the ladder fragments are the points. X = the scan of a fragment and Y = the size in base pair.
-	/// The number of points is, of course, the number of ladder fragments
-	NSUInteger nFragments = trace.fragments.count;
+	/// The total number of ladder fragments.
+	int nFragments;
 	
-	float scans[nFragments];		/// arrays used to compute the polynomial (VLA)
-	float sizes[nFragments];
-
-	float readLength = (float)DefaultReadLength;	/// the read length we will set in case sizing fails
-	int lastPeakScan = 0;
-	int nPoints = 0;
-	for(LadderFragment *fragment in trace.fragments) {
-		float fragmentSize = fragment.size;
-		int scan = fragment.scan;
-		if(scan > lastPeakScan) {
-			lastPeakScan = scan;
-		}
-		if(fragmentSize + 50.0 > readLength) {
-			readLength = fragmentSize + 50.0;
-		}
-		if(scan > 0) {
-			sizes[nPoints] = fragmentSize;
-			scans[nPoints] = scan;
-			nPoints++;
-		}
-	}
+	/// The scan of the last ladder fragment.
+	int lastPeakScan;
 	
-	int k = self.polynomialOrder +1;
-		
-	if (nPoints < 4 || nPoints < nFragments/2 || k < 1 || k > 3) {
-		[self setLinearCoefsForReadLength:readLength];
-		return;
-	}
+	/// The read length to use if the fitting cannot be done.
+	float readLength;
 	
-	/// We compute a linear relation between sizes and scans, which we use as a reference.
-	float sizingSlope, intercept;
-	regression(scans, sizes, nPoints, &sizingSlope, &intercept);
+	/// The order of the polynomial to fit, from 1 to 3. 0 denotes that there are not enough points to fit it.
+	int k;
 	
-	[self managedObjectOriginal_setSizingSlope:sizingSlope];
-	[self managedObjectOriginal_setIntercept:intercept];
+	/// Whether the sample uses a piecewise sizing method, in which case the polynomial is only used as a reference.
+	BOOL piecewise;
 	
-	float coefs[k+1];			/// This will store the results of the fitting.
-	float reversedCoefs[k+1];
-	int info = 0;				/// This will tell whether coefficients are computed
-	polynomialCoefs(scans, sizes, k, nPoints, coefs, &info);
+	/// Whether the coefficients could not be computed or yield a curve that descends before the last fragment.
+	BOOL failed;
 	
-	if(info == 0) {
-		self.coefs = [NSData dataWithBytes:coefs length:(k+1)*sizeof(float)];
-		polynomialCoefs(sizes, scans, k, nPoints, reversedCoefs, &info);
-	}
+	/// The parameters of the linear regression between scans and sizes.
+	float slope, intercept;
+	
+	/// The coefficients of the polynomial relating scans to sizes, and the reverse.
+	float coefs[4], reverseCoefs[4];
 	
-	if(info != 0) {		/// This indicates a failure in finding coefficients.
-		NSLog(@"Failed to compute coefficients for sample %@ using polynomial of order %d.", self.sampleName, k);
-		[self setLinearCoefsForReadLength:readLength];
+	/// The sizing quality.
+	float quality;
+} SizingFit;
+
+
++ (void)computeFittingForSamples:(NSArray<Chromatogram *> *)samples {
+	NSInteger nSamples = samples.count;
+	if(nSamples == 0) {
 		return;
 	}
 	
-	if(k > 1) {
-		/// We check if the coefficients yield a curve that never descends before the last ladder peak.
-		/// This may occur if peaks have very inappropriate sizes during manual assignment.
-		float maxScanSize = yGivenPolynomial(0, coefs, k+1);
-		for (int scan = 1; scan < lastPeakScan + 20; scan += 10) { /// We check every 10 scans
-			float size = yGivenPolynomial(scan, coefs, k+1);
-			if(size < maxScanSize) {
-				/// We discard the fitting in as certain peaks may not be drawable otherwise, preventing manual assignment to sizes.
-				/// The fitting would not be usable anyway.
-				[self setLinearCoefsForReadLength:readLength];
-				NSLog(@"Fitting too poor.");
-				return;
-			} else if(size > maxScanSize){
-				maxScanSize = size;
+	/// We collect the scans and sizes of ladder fragments of all samples in contiguous arrays.
+	/// To size the sample, we fit a polynomial where the ladder fragments are the points. X = the scan of a fragment and Y = the size in base pair.
+	SizingFit *fits = calloc(nSamples, sizeof(SizingFit));
+	NSMutableArray *ladderTraces = [NSMutableArray arrayWithCapacity:nSamples];
+	int capacity = (int)nSamples * 40;
+	float *scans = malloc(capacity * sizeof(float));
+	float *sizes = malloc(capacity * sizeof(float));
+	int totalPoints = 0;
+	
+	for (int i = 0; i < nSamples; i++) {
+		Chromatogram *sample = samples[i];
+		Trace *trace = sample.ladderTrace;
+		SizingFit *fit = &fits[i];
+		fit->k = -1;
+		if(!trace) {
+			[ladderTraces addObject:NSNull.null];
+			continue;
+		}
+		[ladderTraces addObject:trace];
+		
+		NSSet *fragments = trace.fragments;
+		int nFragments = (int)fragments.count;
+		if(totalPoints + nFragments > capacity) {
+			capacity = MAX(capacity * 2, totalPoints + nFragments);
+			scans = realloc(scans, capacity * sizeof(float));
+			sizes = realloc(sizes, capacity * sizeof(float));
+		}
+		
+		fit->firstPoint = totalPoints;
+		fit->nFragments = nFragments;
+		fit->readLength = (float)DefaultReadLength;	/// the read length we will set in case sizing fails
+		for(LadderFragment *fragment in fragments) {
+			float fragmentSize = fragment.size;
+			int scan = fragment.scan;
+			if(scan > fit->lastPeakScan) {
+				fit->lastPeakScan = scan;
+			}
+			if(fragmentSize + 50.0 > fit->readLength) {
+				fit->readLength = fragmentSize + 50.0;
+			}
+			if(scan > 0) {
+				sizes[totalPoints] = fragmentSize;
+				scans[totalPoints] = scan;
+				totalPoints++;
+				fit->nPoints++;
 			}
 		}
+		
+		PolynomialOrder order = sample.polynomialOrder;
+		fit->piecewise = order == LocalSouthern || order == NaturalCubicSpline;
+		/// For piecewise methods, a third-order polynomial is used as a reference to compute reverse coefficients and offsets of ladder fragments.
+		int k = fit->piecewise? ThirdOrderPolynomial +1 : order +1;
+		if (fit->nPoints < 4 || fit->nPoints < fit->nFragments/2 || k < 1 || k > 3) {
+			k = 0;
+		}
+		fit->k = k;
 	}
 	
-	[self managedObjectOriginal_setReverseCoefs:[NSData dataWithBytes:reversedCoefs length:(k+1)*sizeof(float)]];
+	/// We fit all polynomials in one pass, which also computes offsets of ladder fragments.
+	/// These offsets are in the order of sorted scans, which we also record.
+	float *offsets = malloc(MAX(totalPoints, 1) * sizeof(float));
+	float *sortedScans = malloc(MAX(totalPoints, 1) * sizeof(float));
+	fitSizingPolynomials(fits, (int)nSamples, scans, sizes, sortedScans, offsets);
 	
-	/// Our sizing quality criterion is based on the mean of differences of offsets between adjacent fragments relative to their distance in scans
-	/// For that, we sort sizes and scans
-	vDSP_vsort(sizes, nPoints, 1);
-	vDSP_vsort(scans, nPoints, 1);
-	float *offsets = malloc(nPoints * sizeof(float));
-	float maxDiffOffset = 0.0;
-	for (int i = 0; i < nPoints; i++) {
-		offsets[i] = sizes[i] - yGivenPolynomial(scans[i], coefs, k+1);
-		if(i > 0) {
-			/// we raise to a power here so that larger inconsistencies (greater than 1 bp) have an even more negative effect on the sizing quality.
-			float diffOffset = pow(offsets[i-1] - offsets[i],2) / fabs(scans[i-1] - scans[i]);
-			/// If a peak is assigned to the wrong size, this greatly reduces sizing quality
-			
-			if(diffOffset > maxDiffOffset) {
-				maxDiffOffset = diffOffset;
+	/// We apply the results to samples.
+	for (int i = 0; i < nSamples; i++) {
+		Chromatogram *sample = samples[i];
+		SizingFit *fit = &fits[i];
+		if(fit->k < 0) {
+			continue;
+		}
+		if(fit->k == 0) {
+			[sample setLinearCoefsForReadLength:fit->readLength];
+			continue;
+		}
+		
+		[sample managedObjectOriginal_setSizingSlope:fit->slope];
+		[sample managedObjectOriginal_setIntercept:fit->intercept];
+		
+		int k = fit->k;
+		NSData *segmentData;
+		if(fit->piecewise && !fit->failed) {
+			segmentData = piecewiseSizingSegments(&scans[fit->firstPoint], &sizes[fit->firstPoint], fit->nPoints, sample.polynomialOrder);
+			if(segmentData && !sizesIncrease(segmentData, fit->lastPeakScan)) {
+				NSLog(@"Fitting too poor.");
+				segmentData = nil;
 			}
 		}
-	}
-	
-	float score = 1 - maxDiffOffset/0.3 - 0.1*(nFragments-nPoints);
 		
-	if(score < 0) {
-		score = 0;
-	}
-	
-	/// We assign offsets to ladder fragments
-	for(LadderFragment *fragment in trace.fragments) {
-		float scan = (float)fragment.scan;
-		if(scan > 0) {
-			for(int i = 0; i < nPoints; i++) {
-				if(scan == scans[i]) {
-					fragment.offset = offsets[i];
-					break;
+		if(fit->failed || (fit->piecewise && !segmentData)) {
+			/// We discard the fitting in as certain peaks may not be drawable otherwise, preventing manual assignment to sizes.
+			[sample setLinearCoefsForReadLength:fit->readLength];
+			continue;
+		}
+		
+		/// Segments are set first, as setting the coefs recomputes allele sizes.
+		[sample managedObjectOriginal_setSizingSegments:segmentData];
+		sample.coefs = [NSData dataWithBytes:fit->coefs length:(k+1)*sizeof(float)];
+		[sample managedObjectOriginal_setReverseCoefs:[NSData dataWithBytes:fit->reverseCoefs length:(k+1)*sizeof(float)]];
+		
+		/// We assign offsets to ladder fragments
+		const float *fitScans = &sortedScans[fit->firstPoint];
+		const float *fitOffsets = &offsets[fit->firstPoint];
+		for(LadderFragment *fragment in [ladderTraces[i] fragments]) {
+			float scan = (float)fragment.scan;
+			if(scan > 0) {
+				for(int j = 0; j < fit->nPoints; j++) {
+					if(scan == fitScans[j]) {
+						fragment.offset = fitOffsets[j];
+						break;
+					}
 				}
+			} else {
+				fragment.offset = 0;
 			}
-		} else {
-			fragment.offset = 0;
 		}
+		
+		sample.sizingQuality = @(fit->quality);
 	}
 	
-	self.sizingQuality = @(score);
+	free(fits);
+	free(scans);
+	free(sizes);
 	free(offsets);
+	free(sortedScans);
+}
+
+
+/// Returns whether a piecewise sizing function yields a curve that never descends before a given scan.
+///
+/// This may occur if peaks have very inappropriate sizes during manual assignment.
+/// - Parameters:
+///   - segmentData: The segments of the function (see ``Chromatogram/sizingSegments``).
+///   - lastPeakScan: The scan of the last ladder fragment.
+static BOOL sizesIncrease(NSData *segmentData, int lastPeakScan) {
+	float maxScanSize = sizeGivenSegments(0, segmentData);
+	for (int scan = 1; scan < lastPeakScan + 20; scan += 10) { /// We check every 10 scans
+		float size = sizeGivenSegments(scan, segmentData);
+		if(size < maxScanSize) {
+			return NO;
+		} else if(size > maxScanSize){
+			maxScanSize = size;
+		}
+	}
+	return YES;
 }
 
 
 -(void)setLinearCoefsForReadLength:(float)readLength {
 																	
 	float coefs[2] = {0.0, readLength / self.nScans};
+	[self managedObjectOriginal_setSizingSegments:nil];
 	self.coefs = [NSData dataWithBytes: coefs length:2*sizeof(float)];
 	
 	float reverseCoefs[2] = {-coefs[0]/coefs[1], 1/coefs[1]};
@@ -602,53 +688,325 @@ void regressionIgnoringPoint (float *x, float *y, NSInteger nPoints, int pointTo
 
 
 
-/// Fits a polynomial regression of the form y = ax^0 + bx^1 + … + cx^k between two series of values
+/// Fits a polynomial regression of the form y = ax^0 + bx^1 + … + cx^k between two series of values, and returns whether the fitting succeeded.
+///
+/// The function solves the normal equations by Cholesky decomposition, in double precision.
+/// To keep these equations well conditioned, `x` values are centered and scaled before the fitting, and the coefficients are then expressed relative to the original values.
 /// - Parameters:
 ///   - x: Vector of values of the first variable (the "X axis").
 ///   - y: Vector of values of the second variable (the "Y axis").
-///   - k: The order of the polynomial used for the regression. This must not be negative
+///   - k: The order of the polynomial used for the regression, from 0 to 3.
 ///   - nPoints: Number of values to consider for `x` and `y`.
 ///   - b: On output, the coefficients of the polynomial (i.e., results). There will be `k` + 1 coefficients.
-///   - info: On output, te `info` parameter of the `sposv` function, which tells whether the solution has been computed.
-void polynomialCoefs(float *x, float *y, int k, int nPoints, float *b, int *info) {
-	
-	/// we create matrices A and b that specifies the system of equations, as explained in https://neutrium.net/mathematics/least-squares-fitting-of-a-polynomial/ (here A corresponds to the matrix they call "M")
-	int dim =  k+1;					/// the dimension of the A matrix used for fitting
-	float A[dim*dim];				/// the A matrix in the equation Ax = b that we will solve. x represents the coefficient to estimate. We use a 1-dimension array rather than a matrix [dim][dim] to avoid a warning in the sposv call bellow (VLA)
-	float *exponents = malloc(nPoints * sizeof(float));		/// array that we use to populate A.
-	float *x2power = malloc(nPoints * sizeof(float));			/// array that we use to populate A (scans raised to exponents)
-	float *xy = malloc(nPoints * sizeof(float));				/// array that we use to populate b (sizes * scans raised to exponents).
-	float sum;						/// will hold temporary results from summations
-	
-	for (int n = 0; n <= 2*k; n++) {
-		float exponent = n;									/// we will raise x value to the power of n
-		vDSP_vfill(&exponent, exponents, 1, nPoints);		/// for this, we need to create of vector of n's (one n per scan)
-		vvpowf(x2power, exponents, x, &nPoints);			/// so we can use this accelerated function (I couldn't find one in Accelerate that uses a scalar for exponent)
-		if(n <= k) {
-			vDSP_vmul(x2power, 1, y, 1, xy, 1, nPoints);	/// we populate vector b.
-			vDSP_sve(xy, 1, &b[n], nPoints);
-		}
-		vDSP_sve(x2power, 1, &sum, nPoints);				/// we sum the scan2power vector, as A contains such sums
-		for (int i = 0; i <= n; i++) {
-			int j = n-i;
-			if(i > k || j > k) {
+BOOL polynomialCoefs(const float *x, const float *y, int k, int nPoints, float *b) {
+	if(k < 0 || k > 3 || nPoints <= k) {
+		return NO;
+	}
+	int dim = k+1;
+	
+	double mean = 0, scale = 0;
+	for (int p = 0; p < nPoints; p++) {
+		mean += x[p];
+	}
+	mean /= nPoints;
+	for (int p = 0; p < nPoints; p++) {
+		scale = MAX(scale, fabs(x[p] - mean));
+	}
+	if(scale == 0) {
+		return NO;
+	}
+	
+	/// We accumulate the sums of t^n (n = 0…2k) and of y*t^n (n = 0…k), where t is the centered and scaled x value.
+	double powerSums[7] = {0}, yPowerSums[4] = {0};
+	for (int p = 0; p < nPoints; p++) {
+		double t = (x[p] - mean) / scale;
+		double power = 1;
+		for (int n = 0; n <= 2*k; n++) {
+			powerSums[n] += power;
+			if(n <= k) {
+				yPowerSums[n] += power * y[p];
+			}
+			power *= t;
+		}
+	}
+	
+	/// The matrix of the normal equations contains powerSums[i+j] at row i, column j.
+	double A[4][4], L[4][4] = {{0}}, solution[4];
+	for (int i = 0; i < dim; i++) {
+		for (int j = 0; j < dim; j++) {
+			A[i][j] = powerSums[i+j];
+		}
+	}
+	
+	/// We decompose A into L * L^T.
+	for (int j = 0; j < dim; j++) {
+		double sum = A[j][j];
+		for (int p = 0; p < j; p++) {
+			sum -= L[j][p] * L[j][p];
+		}
+		if(sum <= 0) {
+			return NO;		/// The matrix is not positive definite.
+		}
+		L[j][j] = sqrt(sum);
+		for (int i = j+1; i < dim; i++) {
+			double s = A[i][j];
+			for (int p = 0; p < j; p++) {
+				s -= L[i][p] * L[j][p];
+			}
+			L[i][j] = s / L[j][j];
+		}
+	}
+	
+	/// We solve L * z = yPowerSums, then L^T * solution = z.
+	for (int i = 0; i < dim; i++) {
+		double s = yPowerSums[i];
+		for (int p = 0; p < i; p++) {
+			s -= L[i][p] * solution[p];
+		}
+		solution[i] = s / L[i][i];
+	}
+	for (int i = dim-1; i >= 0; i--) {
+		double s = solution[i];
+		for (int p = i+1; p < dim; p++) {
+			s -= L[p][i] * solution[p];
+		}
+		solution[i] = s / L[i][i];
+	}
+	
+	/// The polynomial is sum(solution[n] * ((x - mean)/scale)^n). We expand it to obtain coefficients of powers of x.
+	static const double binomials[4][4] = {{1, 0, 0, 0}, {1, 1, 0, 0}, {1, 2, 1, 0}, {1, 3, 3, 1}};
+	double coefs[4] = {0};
+	double scalePower = 1;
+	for (int n = 0; n < dim; n++) {
+		double minusMeanPower = 1;
+		for (int i = n; i >= 0; i--) {
+			/// The term of x^i in ((x - mean)/scale)^n
+			coefs[i] += solution[n] * binomials[n][i] * minusMeanPower / scalePower;
+			minusMeanPower *= -mean;
+		}
+		scalePower *= scale;
+	}
+	for (int n = 0; n < dim; n++) {
+		b[n] = coefs[n];
+	}
+	return YES;
+}
+
+
+/// Fits the sizing polynomials of several samples in one pass.
+///
+/// For each fit whose `k` is positive, the function computes the linear regression between scans and sizes,
+/// the coefficients of the polynomial relating scans to sizes, and the reverse coefficients.
+/// It checks that the polynomial never descends before the last ladder fragment (unless the fit is `piecewise`), and computes the sizing quality.
+/// The `failed` member of fits whose coefficients could not be computed or are too poor is set to `YES`.
+///
+/// Power sums of the normal equations are accumulated in a single pass over the points of each sample, and all systems are solved by Cholesky decomposition,
+/// which avoids allocating memory and calling LAPACK for each sample.
+/// - Parameters:
+///   - fits: The fits, whose `firstPoint`, `nPoints`, `nFragments`, `lastPeakScan`, `k` and `piecewise` members must be set.
+///   - nFits: The number of elements in `fits`.
+///   - scans: The scans of ladder fragments of all samples (the "X axis").
+///   - sizes: The sizes of ladder fragments of all samples (the "Y axis").
+///   - sortedScans: On output, the scans sorted in ascending order within each fit.
+///   - offsets: On output, the offsets of ladder fragments corresponding to `sortedScans`.
+void fitSizingPolynomials(SizingFit *fits, int nFits, const float *scans, const float *sizes, float *sortedScans, float *offsets) {
+	for (int i = 0; i < nFits; i++) {
+		SizingFit *fit = &fits[i];
+		int k = fit->k;
+		if(k <= 0) {
+			continue;
+		}
+		int nPoints = fit->nPoints;
+		const float *x = &scans[fit->firstPoint];
+		const float *y = &sizes[fit->firstPoint];
+		
+		/// We compute the linear relation between sizes and scans, which we use as a reference.
+		double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+		for (int p = 0; p < nPoints; p++) {
+			sumX += x[p];
+			sumY += y[p];
+			sumXX += (double)x[p] * x[p];
+			sumXY += (double)x[p] * y[p];
+		}
+		fit->slope = (nPoints*sumXY - sumX*sumY)/(nPoints*sumXX - sumX*sumX);
+		fit->intercept = (sumY - fit->slope * sumX)/nPoints;
+		
+		if(!polynomialCoefs(x, y, k, nPoints, fit->coefs) ||
+		   !polynomialCoefs(y, x, k, nPoints, fit->reverseCoefs)) {
+			NSLog(@"Failed to compute coefficients using polynomial of order %d.", k);
+			fit->failed = YES;
+			continue;
+		}
+		
+		if(k > 1 && !fit->piecewise) {
+			/// We check if the coefficients yield a curve that never descends before the last ladder peak.
+			float maxScanSize = yGivenPolynomial(0, fit->coefs, k+1);
+			for (int scan = 1; scan < fit->lastPeakScan + 20; scan += 10) { /// We check every 10 scans
+				float size = yGivenPolynomial(scan, fit->coefs, k+1);
+				if(size < maxScanSize) {
+					NSLog(@"Fitting too poor.");
+					fit->failed = YES;
+					break;
+				} else if(size > maxScanSize){
+					maxScanSize = size;
+				}
+			}
+			if(fit->failed) {
 				continue;
 			}
-			A[i*dim + j] = sum;
+		}
+		
+		/// Our sizing quality criterion is based on the mean of differences of offsets between adjacent fragments relative to their distance in scans
+		/// For that, we sort sizes and scans
+		float sortedSizes[nPoints];
+		float *fitScans = &sortedScans[fit->firstPoint];
+		float *fitOffsets = &offsets[fit->firstPoint];
+		memcpy(sortedSizes, y, nPoints * sizeof(float));
+		memcpy(fitScans, x, nPoints * sizeof(float));
+		vDSP_vsort(sortedSizes, nPoints, 1);
+		vDSP_vsort(fitScans, nPoints, 1);
+		float maxDiffOffset = 0.0;
+		for (int p = 0; p < nPoints; p++) {
+			fitOffsets[p] = sortedSizes[p] - yGivenPolynomial(fitScans[p], fit->coefs, k+1);
+			if(p > 0) {
+				/// we raise to a power here so that larger inconsistencies (greater than 1 bp) have an even more negative effect on the sizing quality.
+				float diffOffset = pow(fitOffsets[p-1] - fitOffsets[p],2) / fabs(fitScans[p-1] - fitScans[p]);
+				/// If a peak is assigned to the wrong size, this greatly reduces sizing quality
+				if(diffOffset > maxDiffOffset) {
+					maxDiffOffset = diffOffset;
+				}
+			}
+		}
+		
+		float score = 1 - maxDiffOffset/0.3 - 0.1*(fit->nFragments-nPoints);
+		fit->quality = score < 0? 0 : score;
+	}
+}
+
+
+/// Computes the coefficients of the second-order polynomial passing through three points, expressed relative to a base value of `x`.
+///
+/// - Parameters:
+///   - x: The values of the three points on the x axis, which must differ.
+///   - y: The values of the three points on the y axis.
+///   - baseX: The value of x from which distances are computed. The polynomial is y = `coefs[0]` + `coefs[1]`d + `coefs[2]`d^2, where d = x - `baseX`.
+///   - coefs: On output, the three coefficients of the polynomial.
+void quadraticThroughPoints(const float *x, const float *y, float baseX, float *coefs) {
+	/// We use Newton's form: y = y0 + f01(x-x0) + f012(x-x0)(x-x1), where f01 and f012 are divided differences.
+	float f01 = (y[1] - y[0]) / (x[1] - x[0]);
+	float f12 = (y[2] - y[1]) / (x[2] - x[1]);
+	float f012 = (f12 - f01) / (x[2] - x[0]);
+	float a = baseX - x[0], b = baseX - x[1];
+	coefs[0] = y[0] + f01*a + f012*a*b;
+	coefs[1] = f01 + f012*(a+b);
+	coefs[2] = f012;
+}
+
+
+/// Returns the segments of a piecewise function relating scans (x) and sizes (y), or `nil` if the function could not be computed.
+///
+/// The data returned is an array of `SizingSegment` structs, as described in ``Chromatogram/sizingSegments``.
+/// - Parameters:
+///   - x: Vector of scans.
+///   - y: Vector of sizes.
+///   - nPoints: Number of values to consider for `x` and `y`. This must be at least 3.
+///   - method: The piecewise method (``PolynomialOrder/LocalSouthern`` or ``PolynomialOrder/NaturalCubicSpline``).
+NSData *_Nullable piecewiseSizingSegments(const float *x, const float *y, int nPoints, PolynomialOrder method) {
+	if(nPoints < 3) {
+		return nil;
+	}
+	
+	/// We sort points by scan.
+	float sortedX[nPoints], sortedY[nPoints];
+	vDSP_Length indices[nPoints];
+	for (int i = 0; i < nPoints; i++) {
+		indices[i] = i;
+	}
+	vDSP_vsorti(x, indices, NULL, nPoints, 1);
+	for (int i = 0; i < nPoints; i++) {
+		sortedX[i] = x[indices[i]];
+		sortedY[i] = y[indices[i]];
+		if(i > 0 && sortedX[i] <= sortedX[i-1]) {
+			/// Two fragments at the same scan make the function undefined.
+			return nil;
+		}
+	}
+	
+	if(method != LocalSouthern && method != NaturalCubicSpline) {
+		return nil;
+	}
+	
+	/// Segments between points are preceded by a linear segment before the first point and followed by a linear segment after the last point.
+	int nSegments = nPoints+1;
+	NSMutableData *segmentData = [NSMutableData dataWithLength:nSegments * sizeof(SizingSegment)];
+	SizingSegment *segments = segmentData.mutableBytes;
+	
+	if(method == LocalSouthern) {
+		for (int i = 0; i < nPoints-1; i++) {
+			SizingSegment *segment = &segments[i+1];
+			segment->startScan = sortedX[i];
+			/// We average the second-order polynomials passing through points i-1, i, i+1 and i, i+1, i+2, when these points exist.
+			int nCurves = 0;
+			for (int first = i-1; first <= i; first++) {
+				if(first < 0 || first + 2 >= nPoints) {
+					continue;
+				}
+				float curveCoefs[3];
+				quadraticThroughPoints(&sortedX[first], &sortedY[first], sortedX[i], curveCoefs);
+				for (int n = 0; n < 3; n++) {
+					segment->coefs[n] += curveCoefs[n];
+				}
+				nCurves++;
+			}
+			for (int n = 0; n < 3; n++) {
+				segment->coefs[n] /= nCurves;
+			}
+		}
+	} else {
+		/// We compute the second derivatives at each point (M), which are 0 at the first and last point, by solving a tridiagonal system (Thomas algorithm).
+		float h[nPoints-1], M[nPoints], c[nPoints], d[nPoints];
+		for (int i = 0; i < nPoints-1; i++) {
+			h[i] = sortedX[i+1] - sortedX[i];
+		}
+		M[0] = 0; M[nPoints-1] = 0;
+		c[0] = 0; d[0] = 0;
+		for (int i = 1; i < nPoints-1; i++) {
+			float rhs = 6 * ((sortedY[i+1] - sortedY[i])/h[i] - (sortedY[i] - sortedY[i-1])/h[i-1]);
+			float denominator = 2 * (h[i-1] + h[i]) - h[i-1] * c[i-1];
+			c[i] = h[i] / denominator;
+			d[i] = (rhs - h[i-1] * d[i-1]) / denominator;
+		}
+		for (int i = nPoints-2; i > 0; i--) {
+			M[i] = d[i] - c[i] * M[i+1];
+		}
+		
+		for (int i = 0; i < nPoints-1; i++) {
+			SizingSegment *segment = &segments[i+1];
+			segment->startScan = sortedX[i];
+			segment->coefs[0] = sortedY[i];
+			segment->coefs[1] = (sortedY[i+1] - sortedY[i])/h[i] - h[i] * (2*M[i] + M[i+1])/6;
+			segment->coefs[2] = M[i]/2;
+			segment->coefs[3] = (M[i+1] - M[i]) / (6*h[i]);
 		}
 	}
-	free(exponents); free(x2power); free(xy);
 	
-	/// we solve the system Ax = b using LAPACK's sposv, as the A matrix is always symmetric and positive definite
-	char uplo = 'U';		/// specifies the lower triangle of the matrix (this doesn't matter since we have filled the whole matrix)
-	int nColB = 1;			/// number of columns of b
-	sposv_(&uplo, &dim, &nColB, A, &dim, b, &dim, info);		/// results are put in b
+	/// Beyond ladder fragments, sizes extend linearly with the slope of the curve at the first or last point.
+	/// The first segment has the same startScan as the next one, hence it only applies to scans before the first point.
+	segments[0].startScan = sortedX[0];
+	segments[0].coefs[0] = sortedY[0];
+	segments[0].coefs[1] = segments[1].coefs[1];
 	
+	const SizingSegment *lastCurve = &segments[nPoints-1];
+	float lastLength = sortedX[nPoints-1] - sortedX[nPoints-2];
+	segments[nPoints].startScan = sortedX[nPoints-1];
+	segments[nPoints].coefs[0] = sortedY[nPoints-1];
+	segments[nPoints].coefs[1] = lastCurve->coefs[1] + 2*lastCurve->coefs[2]*lastLength + 3*lastCurve->coefs[3]*lastLength*lastLength;
+	return segmentData;
 }
 
 
 - (float)readLength {
-	if(self.sizes.length > 0) {
+	if([self sizingData].length > 0) {
 		return _readLength;
 	}
 	return DefaultReadLength;
@@ -666,89 +1024,175 @@ void polynomialCoefs(float *x, float *y, int k, int nPoints, float *b, int *info
 
 
 - (float)startSize {
-	if(self.sizes.length > 0) {
+	if([self sizingData].length > 0) {
 		return _startSize;;
 	}
 	return 0;
 }
 
 
+- (int)minScan {
+	if([self sizingData].length > 0) {
+		return _minScan;
+	}
+	return 0;
+}
+
+
+- (int)maxScan {
+	if([self sizingData].length > 0) {
+		return _maxScan;;
+	}
+	return self.nScans;
+}
+
+
+/// Returns the size at a scan given sizing data, which are the segments of a piecewise function if `piecewise` is `YES`, and polynomial coefficients otherwise.
+static inline float sizeGivenSizingData(float scan, NSData *sizingData, BOOL piecewise) {
+	return piecewise? sizeGivenSegments(scan, sizingData) : sizeGivenCoefs(scan, sizingData);
+}
+
+
+/// Computes the sizes of consecutive scans given sizing data, as in `sizeGivenSizingData()`.
+static inline void sizesGivenSizingDataForRange(int firstScan, int count, NSData *sizingData, BOOL piecewise, float *sizes) {
+	if(piecewise) {
+		sizesGivenSegmentsForRange(firstScan, count, sizingData, sizes);
+	} else {
+		sizesGivenCoefsForRange(firstScan, count, sizingData, sizes);
+	}
+}
+
+
 - (NSData *)sizes {
-	NSData *coefs = self.primitiveCoefs;
-	if(_sizes.length == 0 || previousCoefs != coefs) {
-		if(!coefs) {
-			[self computeFitting];		/// this method modifies core data attribute, hence may generate undo actions that may not be desirable. 
-										/// This is why we compute sizing coefficients on sample import.
+	NSData *sizingData = [self sizingData];
+	NSData *sizes = _sizes;
+	if(sizes.length == 0 && sizingData.length > 0 && self.nScans > 0) {
+		/// Samples having the same sizing share the same array, via the cache.
+		int nScans = self.nScans;
+		SizeArrayCache *cache = SizeArrayCache.sharedCache;
+		sizes = [cache sizesForCoefs:sizingData nScans:nScans];
+		if(!sizes) {
+			float *computedSizes = malloc(nScans * sizeof(float));
+			sizesGivenSizingDataForRange(0, nScans, sizingData, piecewiseSizing, computedSizes);
+			/// The data object takes ownership of the buffer, which avoids a copy.
+			sizes = [NSData dataWithBytesNoCopy:computedSizes length:nScans * sizeof(float) freeWhenDone:YES];
+			[cache setSizes:sizes forCoefs:sizingData nScans:nScans];
 		}
-		[self computeSizes];
+		_sizes = sizes;
+	} else {
+		[DataCache.sharedCache useData:sizes];
 	}
-	return _sizes;
+	return sizes;
 }
 
 
-/// Computes and sets the `size` attribute.
-- (void)computeSizes {
-	
-	NSData *coefData = self.coefs;
-	previousCoefs = coefData;
-	if(self.nScans == 0 || coefData.length == 0) {
+- (void)getSizes:(float *)sizes fromScan:(int)firstScan count:(int)count {
+	if(count <= 0) {
 		return;
 	}
-	int nScans = self.nScans;
-	float *scans = malloc(nScans * sizeof(float));		/// the scan indices: 0...nScans-1. We use float for compatibility with vDSP functions
-	float *computedSizes = calloc(nScans, sizeof(float));
-	float *exponents = malloc(nScans * sizeof(float));
-	float *scan2power = malloc(nScans * sizeof(float));
-	
-	float start = 0;
-	float B = 1;
-	vDSP_vramp(&start, &B, scans, 1, nScans);
-	const float *a = coefData.bytes;
-	NSInteger order = coefData.length / sizeof(float);
-	for (int n = 0; n < order; n++) {
-		float exponent = n;						/// we will raise scans to the power of n
-		vDSP_vfill(&exponent, exponents, 1, nScans);
-		
-		/// so we can use this accelerated function (I couldn't find one in Accelerate that uses a scalar for exponent)
-		vvpowf(scan2power, exponents, scans, &nScans);
-		vDSP_vsmul(scan2power, 1, &a[n], scan2power, 1, nScans);
-		vDSP_vadd(computedSizes, 1, scan2power, 1, computedSizes, 1, nScans);
-	}
-	
-	free(scans);
-	free(exponents);
-	free(scan2power);
-	scans = NULL;
-	exponents = NULL;
-	scan2power = NULL;
-	
-	/// we compute minScan, maxScan and readLength based on the sizing
-	vDSP_Length maxScan = nScans-1, minScan = 0;
-	float max = computedSizes[maxScan], min = computedSizes[0];
-	
-	if(computedSizes[maxScan] < computedSizes[maxScan-1]) {
-		vDSP_maxvi(computedSizes, 1, &max, &maxScan, nScans);
+	NSData *sizingData = [self sizingData];
+	NSData *sizeData = _sizes;
+	if(sizeData.length == 0 && sizingData.length > 0) {
+		sizeData = [SizeArrayCache.sharedCache sizesForCoefs:sizingData nScans:self.nScans];
 	}
-	if(computedSizes[0] > computedSizes[1]) {
-		vDSP_minvi(computedSizes, 1, &min, &minScan, maxScan);
+	if(firstScan >= 0 && sizeData.length >= (firstScan + count) * sizeof(float)) {
+		/// The sizes have already been computed.
+		const float *allSizes = sizeData.bytes;
+		memcpy(sizes, allSizes + firstScan, count * sizeof(float));
+	} else if(sizingData.length > 0) {
+		sizesGivenSizingDataForRange(firstScan, count, sizingData, piecewiseSizing, sizes);
+	} else {
+		memset(sizes, 0, count * sizeof(float));
 	}
-	self.startSize = min;
-	self.readLength = max;
-	self.minScan = (int)minScan;
-	self.maxScan = (int)maxScan;
-	
-	self.sizes = [NSData dataWithBytes:computedSizes length:nScans * sizeof(float)];
-	
-	free(computedSizes);
-	computedSizes = NULL;
 }
 
 
-- (int)maxScan {
-	if(self.sizes.length > 0) {
-		return _maxScan;;
+/// Returns the data from which sizes are computed, which are the ``sizingSegments`` if the sample uses a piecewise method, and the ``coefs`` otherwise,
+/// after making sure that ``minScan``, ``maxScan``, ``startSize`` and ``readLength`` correspond to this data.
+///
+/// This method does not materialize the ``sizes`` array.
+- (nullable NSData *)sizingData {
+	NSData *coefs = self.primitiveCoefs;
+	if(previousCoefs != coefs || !coefs) {
+		if(!coefs) {
+			[self computeFitting];		/// this method modifies core data attribute, hence may generate undo actions that may not be desirable.
+										/// This is why we compute sizing coefficients on sample import.
+		}
+		coefs = self.coefs;
+		/// The segments are always set with the coefs, hence a change in coefs denotes a change in sizing.
+		NSData *segments = self.sizingSegments;
+		piecewiseSizing = segments.length >= sizeof(SizingSegment);
+		_sizingData = piecewiseSizing? segments : coefs;
+		_sizes = nil;
+		previousCoefs = coefs;
+		[self computeSizingRange];
+	}
+	return _sizingData;
+}
+
+
+/// Computes ``minScan``, ``maxScan``, ``startSize`` and ``readLength`` for the current sizing data.
+///
+/// Sizes are computed by chunks in a buffer on the stack, so that the whole array of sizes is not allocated.
+- (void)computeSizingRange {
+	NSData *sizingData = _sizingData;
+	int nScans = self.nScans;
+	if(nScans < 2 || sizingData.length == 0) {
+		return;
 	}
-	return self.nScans;
+	/// We reproduce what vDSP_maxvi and vDSP_minvi would return on the full array:
+	/// the first scan with the largest size, and the first scan with the lowest size before it.
+	float max = -INFINITY, min = INFINITY, minBeforeMax = INFINITY;
+	int scanOfMax = 0, scanOfMin = 0, scanOfMinBeforeMax = 0;
+	float firstSizes[2], lastSizes[2];
+	
+	const int chunkLength = 1024;
+	float chunk[chunkLength];
+	for (int firstScan = 0; firstScan < nScans; firstScan += chunkLength) {
+		int count = MIN(chunkLength, nScans - firstScan);
+		sizesGivenSizingDataForRange(firstScan, count, sizingData, piecewiseSizing, chunk);
+		for (int i = 0; i < count; i++) {
+			int scan = firstScan + i;
+			float size = chunk[i];
+			if(scan < 2) {
+				firstSizes[scan] = size;
+			}
+			if(scan >= nScans - 2) {
+				lastSizes[scan - nScans + 2] = size;
+			}
+			if(size > max) {
+				max = size;
+				scanOfMax = scan;
+				minBeforeMax = min;
+				scanOfMinBeforeMax = scanOfMin;
+			}
+			if(scan < nScans-1 && size < min) {
+				/// The minimum size is searched before the last scan, which is the default maxScan.
+				min = size;
+				scanOfMin = scan;
+			}
+		}
+	}
+	
+	/// we compute minScan, maxScan and readLength based on the sizing
+	int maxScan = nScans-1, minScan = 0;
+	float maxSize = lastSizes[1], minSize = firstSizes[0];
+	float minBeforeMaxScan = min;
+	int scanOfMinBeforeMaxScan = scanOfMin;
+	if(lastSizes[1] < lastSizes[0]) {
+		maxScan = scanOfMax;
+		maxSize = max;
+		minBeforeMaxScan = minBeforeMax;
+		scanOfMinBeforeMaxScan = scanOfMinBeforeMax;
+	}
+	if(firstSizes[0] > firstSizes[1] && maxScan > 0) {
+		minSize = minBeforeMaxScan;
+		minScan = scanOfMinBeforeMaxScan;
+	}
+	self.startSize = minSize;
+	self.readLength = maxSize;
+	_minScan = minScan;
+	_maxScan = maxScan;
 }
 
 
@@ -761,70 +1205,181 @@ void polynomialCoefs(float *x, float *y, int k, int nPoints, float *b, int *info
 			return -1;
 		}
 	}
-	return yGivenPolynomial(scan, coefData.bytes, (int)coefData.length/sizeof(float));
+	NSData *segments = self.sizingSegments;
+	if(segments.length >= sizeof(SizingSegment)) {
+		return sizeGivenSegments(scan, segments);
+	}
+	return sizeGivenCoefs(scan, coefData);
 }
 
 
 - (int)scanForSize:(float)size {
-	NSData *sizeData = self.sizes;
-	const float *sizes = sizeData.bytes;
-	int nScans = (int)sizeData.length/sizeof(float);
-	if(size <= sizes[0]) {
-		return 0;
+	float scan = [self fractionalScanForSize:size];
+	if(scan < 0) {
+		return -1;
+	}
+	/// As sizes are interpolated linearly between scans, the closest integer scan is the one whose size is the closest to `size`.
+	return (int)lroundf(scan);
+}
+
+
+/// Returns the size at a scan, using an array of sizes if available, or sizing data otherwise.
+static inline float sizeAtScan(int scan, const float *sizes, NSData *sizingData, BOOL piecewise) {
+	return sizes? sizes[scan] : sizeGivenSizingData(scan, sizingData, piecewise);
+}
+
+
+- (float)fractionalScanForSize:(float)size {
+	NSData *coefData = [self sizingData];
+	BOOL piecewise = piecewiseSizing;
+	int nScans = self.nScans;
+	if(coefData.length == 0 || nScans == 0) {
+		return -1;
 	}
-	if(size >= sizes[nScans-1]) {
-		return nScans-1;
+	/// If the array of sizes is available, we use it. Otherwise we evaluate the sizing function at the few scans we need, rather than materializing the array.
+	NSData *sizeData = _sizes;
+	if(sizeData.length == 0) {
+		sizeData = [SizeArrayCache.sharedCache sizesForCoefs:coefData nScans:nScans];
 	}
+	const float *sizes = sizeData.length >= nScans * sizeof(float)? sizeData.bytes : NULL;
 	
-	NSData *reverseCoefs = self.reverseCoefs;
-	if(!reverseCoefs) {
-		[self computeFitting];
-		reverseCoefs = self.reverseCoefs;
-		if(!reverseCoefs || !self.coefs) {
-			return -1;
-		}
+	/// Sizes increase between minScan and maxScan (see computeSizingRange), so we can find the scan by binary search in this range.
+	/// Sizes outside this range are clamped to its ends. The sizes of the first and last scans are not used, as the sizing function may decrease beyond the range.
+	int low = _minScan, high = _maxScan;
+	if(low < 0 || high >= nScans || low > high) {
+		low = 0;
+		high = nScans-1;
+	}
+	float lowSize = sizeAtScan(low, sizes, coefData, piecewise), highSize = sizeAtScan(high, sizes, coefData, piecewise);
+	if(size <= lowSize) {
+		return low;
 	}
-	int scan = yGivenPolynomial(size, reverseCoefs.bytes, (int)reverseCoefs.length/sizeof(float));
-	
-	/// the scan returned may not be the closest to the size, as the reverse coefs do not do the exact reverse of what the coefs do (which is expected)
-	/// but as this scan should be close to the scan we want, we find it by iteration
-	if (scan >= nScans) {
-		scan = nScans-1;
-	} else if(scan < 0) {
-		scan = 0;
-	}
-	float dist = sizes[scan] - size;
-	float minDist = fabs(dist);
-	int increment = dist < 0? 1 : -1;
-	while (scan >= -increment && scan < nScans-increment) {
-		scan += increment;
-		dist = fabs(sizes[scan] - size);
-		if(dist > minDist) {
-			scan -= increment;
-			break;
+	if(size >= highSize) {
+		return high;
+	}
+	
+	/// We find the two consecutive scans whose sizes bracket `size`, such that sizes[low] < size <= sizes[high].
+	while (high - low > 1) {
+		int middle = low + (high - low)/2;
+		float middleSize = sizeAtScan(middle, sizes, coefData, piecewise);
+		if(middleSize < size) {
+			low = middle;
+			lowSize = middleSize;
 		} else {
-			minDist = dist;
+			high = middle;
+			highSize = middleSize;
 		}
 	}
 	
-	return scan;
+	float sizeRange = highSize - lowSize;
+	if(sizeRange <= 0) {
+		return high;
+	}
+	return low + (size - lowSize) / sizeRange;
 }
 
-/// Returns the value of `y` given the value of `x` assuming a relationship y = ax^0 + bx^1 + … + cx^k
-///
-/// - Parameters:
-///   - x: The value for which we want to compute the y value.
-///   - coefs: The coefficient of the polynomial (a, b, c... see description).
-///   - k: The order of the polynomial (the number of values in `coefs`, minus one).
+
 float yGivenPolynomial(float x, const float *coefs, int k) {
-	float y = 0;
-	for (int n = 0; n < k; n++) {
-		y += coefs[n] * pow(x, n);
+	if(k <= 0) {
+		return 0;
+	}
+	/// We use Horner's method, which avoids computing powers.
+	float y = coefs[k-1];
+	for (int n = k-2; n >= 0; n--) {
+		y = y * x + coefs[n];
 	}
 	return y;
 }
 
 
+void yGivenPolynomialForRange(float firstX, int count, const float *coefs, int k, float *y) {
+	if(count <= 0) {
+		return;
+	}
+	if(k <= 0) {
+		memset(y, 0, count * sizeof(float));
+		return;
+	}
+	/// We evaluate the polynomial on 8 consecutive values at once, using Horner's method.
+	const simd_float8 ramp = {0, 1, 2, 3, 4, 5, 6, 7};
+	const float highestCoef = coefs[k-1];
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		simd_float8 x = ramp + (firstX + i);
+		simd_float8 values = highestCoef;
+		for (int n = k-2; n >= 0; n--) {
+			values = values * x + coefs[n];
+		}
+		/// `y` may not be aligned for simd_float8, hence the packed type.
+		*(simd_packed_float8 *)(y + i) = values;
+	}
+	/// The remaining values are computed one by one.
+	for (; i < count; i++) {
+		y[i] = yGivenPolynomial(firstX + i, coefs, k);
+	}
+}
+
+
+/// Returns the size at a scan given the segment that applies to this scan.
+static inline float sizeGivenSegment(float scan, const SizingSegment *segment) {
+	float d = scan - segment->startScan;
+	const float *coefs = segment->coefs;
+	return ((coefs[3] * d + coefs[2]) * d + coefs[1]) * d + coefs[0];
+}
+
+
+float sizeGivenCoefs(float scan, NSData *coefs) {
+	return yGivenPolynomial(scan, coefs.bytes, (int)(coefs.length / sizeof(float)));
+}
+
+
+void sizesGivenCoefsForRange(int firstScan, int count, NSData *coefs, float *sizes) {
+	if(count <= 0) {
+		return;
+	}
+	yGivenPolynomialForRange(firstScan, count, coefs.bytes, (int)(coefs.length / sizeof(float)), sizes);
+}
+
+
+float sizeGivenSegments(float scan, NSData *segmentData) {
+	const SizingSegment *segments = segmentData.bytes;
+	int nSegments = (int)(segmentData.length / sizeof(SizingSegment));
+	if(nSegments == 0) {
+		return 0;
+	}
+	/// We find the last segment whose start is not after the scan.
+	int low = 0, high = nSegments-1;
+	while (low < high) {
+		int middle = low + (high - low + 1)/2;
+		if(segments[middle].startScan <= scan) {
+			low = middle;
+		} else {
+			high = middle-1;
+		}
+	}
+	return sizeGivenSegment(scan, &segments[low]);
+}
+
+
+void sizesGivenSegmentsForRange(int firstScan, int count, NSData *segmentData, float *sizes) {
+	const SizingSegment *segments = segmentData.bytes;
+	int nSegments = (int)(segmentData.length / sizeof(SizingSegment));
+	if(count <= 0 || nSegments == 0) {
+		return;
+	}
+	
+	/// As scans are consecutive, we find the segment of the first scan, then move to the next segment when its start is reached.
+	int segmentIndex = 0;
+	for (int i = 0; i < count; i++) {
+		float scan = firstScan + i;
+		while(segmentIndex < nSegments-1 && segments[segmentIndex+1].startScan <= scan) {
+			segmentIndex++;
+		}
+		sizes[i] = sizeGivenSegment(scan, &segments[segmentIndex]);
+	}
+}
+
+
 - (nullable Trace *)ladderTrace {		/// returns the trace that is the ladder
 	for(Trace *trace in self.traces) {
 		if(trace.isLadder) {
@@ -857,6 +1412,106 @@ float yGivenPolynomial(float x, const float *coefs, int k) {
 	}]];
 }
 
+
++ (void)prefetchTableContentForSamples:(NSSet<Chromatogram *> *)samples {
+	NSManagedObjectContext *MOC = samples.anyObject.managedObjectContext;
+	if(!MOC) {
+		return;
+	}
+	/// Samples whose genotypes are in memory are skipped, so that selecting a folder again does not repeat the fetch.
+	NSMutableArray *samplesToFetch = NSMutableArray.new;
+	for(Chromatogram *sample in samples) {
+		if(sample.isFault || [sample hasFaultForRelationshipNamed:ChromatogramGenotypesKey]) {
+			[samplesToFetch addObject:sample];
+		}
+	}
+	
+	NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:Chromatogram.entity.name];
+	request.relationshipKeyPathsForPrefetching = @[ChromatogramPanelKey, ChromatogramSizeStandardKey, ChromatogramGenotypesKey,
+												   @"genotypes.marker", @"genotypes.alleles"];
+	/// Batches keep the number of arguments of the SQL query reasonable.
+	const NSUInteger batchSize = 10000;
+	for (NSUInteger start = 0; start < samplesToFetch.count; start += batchSize) {
+		NSArray *batch = [samplesToFetch subarrayWithRange:NSMakeRange(start, MIN(batchSize, samplesToFetch.count - start))];
+		request.predicate = [NSPredicate predicateWithFormat:@"self IN %@", batch];
+		NSError *error;
+		if(![MOC executeFetchRequest:request error:&error]) {
+			NSLog(@"Failed to prefetch samples: %@", error);
+			return;
+		}
+	}
+}
+
+
++ (nullable NSArray<Chromatogram *> *)samplesWithIDs:(NSArray<NSManagedObjectID *> *)sampleIDs inContext:(NSManagedObjectContext *)context
+									prefetchingKeyPaths:(NSArray<NSString *> *)keyPaths error:(NSError **)error {
+	NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:Chromatogram.entity.name];
+	request.relationshipKeyPathsForPrefetching = keyPaths;
+	NSMutableDictionary<NSManagedObjectID *, Chromatogram *> *fetchedSamples = [NSMutableDictionary dictionaryWithCapacity:sampleIDs.count];
+	/// Batches keep the number of arguments of the SQL query reasonable.
+	const NSUInteger batchSize = 10000;
+	for (NSUInteger start = 0; start < sampleIDs.count; start += batchSize) {
+		NSArray *batch = [sampleIDs subarrayWithRange:NSMakeRange(start, MIN(batchSize, sampleIDs.count - start))];
+		request.predicate = [NSPredicate predicateWithFormat:@"self IN %@", batch];
+		NSArray<Chromatogram *> *samples = [context executeFetchRequest:request error:error];
+		if(!samples) {
+			return nil;
+		}
+		for(Chromatogram *sample in samples) {
+			fetchedSamples[sample.objectID] = sample;
+		}
+	}
+	
+	NSMutableArray<Chromatogram *> *samples = [NSMutableArray arrayWithCapacity:fetchedSamples.count];
+	for(NSManagedObjectID *sampleID in sampleIDs) {
+		Chromatogram *sample = fetchedSamples[sampleID];
+		if(sample) {
+			[samples addObject:sample];
+		}
+	}
+	return samples;
+}
+
+
++ (BOOL)deleteSamplesWithIDs:(NSArray<NSManagedObjectID *> *)sampleIDs inContext:(NSManagedObjectContext *)context
+		mergingChangesIntoContexts:(NSArray<NSManagedObjectContext *> *)contexts
+						  progress:(nullable NSProgress *)progress error:(NSError **)error {
+	if(sampleIDs.count == 0) {
+		return YES;
+	}
+	/// The blobs of traces may no longer be referenced.
+	[BlobStore.sharedStore setNeedsCollection];
+	
+	/// The entities to delete with the predicate selecting their objects for a batch of samples, in the order of deletion.
+	NSArray<NSArray<NSString *> *> *deletions = @[@[Allele.entity.name, @"genotype.sample IN %@"],
+												  @[LadderFragment.entity.name, @"trace.chromatogram IN %@"],
+												  @[Genotype.entity.name, @"sample IN %@"],
+												  @[Trace.entity.name, @"chromatogram IN %@"],
+												  @[Chromatogram.entity.name, @"self IN %@"]];
+	const NSUInteger batchSize = 1000;
+	for (NSUInteger start = 0; start < sampleIDs.count; start += batchSize) {
+		@autoreleasepool {
+			NSArray *batch = [sampleIDs subarrayWithRange:NSMakeRange(start, MIN(batchSize, sampleIDs.count - start))];
+			NSMutableArray *deletedIDs = NSMutableArray.new;
+			for(NSArray<NSString *> *deletion in deletions) {
+				NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:deletion.firstObject];
+				request.predicate = [NSPredicate predicateWithFormat:deletion.lastObject, batch];
+				NSBatchDeleteRequest *deleteRequest = [[NSBatchDeleteRequest alloc] initWithFetchRequest:request];
+				deleteRequest.resultType = NSBatchDeleteResultTypeObjectIDs;
+				NSBatchDeleteResult *result = [context executeRequest:deleteRequest error:error];
+				if(!result) {
+					return NO;
+				}
+				[deletedIDs addObjectsFromArray:result.result];
+			}
+			/// Contexts would otherwise keep deleted objects, which they would fail to fulfill.
+			[NSManagedObjectContext mergeChangesFromRemoteContextSave:@{NSDeletedObjectsKey: deletedIDs} intoContexts:contexts];
+			progress.completedUnitCount += batch.count;
+		}
+	}
+	return YES;
+}
+
 #pragma mark - accessors
 
 - (NSString *)dye1 {
@@ -895,7 +1550,7 @@ float yGivenPolynomial(float x, const float *coefs, int k) {
 
 
 - (void)setPolynomialOrder:(PolynomialOrder)polynomialOrder {
-	if(polynomialOrder < -1 || polynomialOrder > 3 || polynomialOrder == self.polynomialOrder) {
+	if(polynomialOrder < NoFittingMethod || polynomialOrder > NaturalCubicSpline || polynomialOrder == self.polynomialOrder) {
 		return;
 	}
 	[self managedObjectOriginal_setPolynomialOrder:polynomialOrder];
@@ -906,6 +1561,23 @@ float yGivenPolynomial(float x, const float *coefs, int k) {
 }
 
 
++ (void)setPolynomialOrder:(PolynomialOrder)polynomialOrder forSamples:(NSArray<Chromatogram *> *)samples {
+	if(polynomialOrder < NoFittingMethod || polynomialOrder > NaturalCubicSpline) {
+		return;
+	}
+	NSMutableArray *samplesToFit = [NSMutableArray arrayWithCapacity:samples.count];
+	for(Chromatogram *sample in samples) {
+		if(sample.polynomialOrder != polynomialOrder) {
+			[sample managedObjectOriginal_setPolynomialOrder:polynomialOrder];
+			if(!sample.deleted) {
+				[samplesToFit addObject:sample];
+			}
+		}
+	}
+	[self computeFittingForSamples:samplesToFit];
+}
+
+
 
 -(void)applyPanelWithAlleleName:(NSString *)alleleName {
 	/// we remove genotypes the sample may have from a previous panel (genotypes delete themselves when they lose their sample)
@@ -1090,8 +1762,8 @@ int scanForSize(float size, const float *reverseCoefs, int k) {
 		[self managedObjectOriginal_setTraces: [coder decodeObjectOfClasses:[NSSet setWithObjects:NSSet.class, Trace.class, nil] forKey:ChromatogramTracesKey]];
 		[self managedObjectOriginal_setGenotypes: [coder decodeObjectOfClasses:[NSSet setWithObjects:NSSet.class, Genotype.class, nil]  forKey:ChromatogramGenotypesKey]];
 		
-		if(![identifiers containsObject:@"1.2"]) {
-			/// Crosstalk detection was improved in this version.
+		if(![identifiers containsObject:@"1.2"] && ![identifiers containsObject:@"1.3"]) {
+			/// Crosstalk detection was improved in version 1.2.
 			for (Trace *trace in self.traces) {
 				[trace findCrossTalk];
 			}
@@ -1205,17 +1877,15 @@ int scanForSize(float size, const float *reverseCoefs, int k) {
 
 
 -(void)refreshSizeData {
-	if(_sizes) {
-		self.sizes = nil;
-	}
+	_sizes = nil;
 }
 
 
 - (void)didTurnIntoFault {
 	[super didTurnIntoFault];
-	if(_sizes) {
-		self.sizes = nil;
-	}
+	_sizes = nil;
+	_sizingData = nil;
+	previousCoefs = nil;
 }
 
 
@@ -96,6 +96,54 @@ NS_ASSUME_NONNULL_BEGIN
 /// - Parameter annotateSuppPeaks: Whether additional peaks should be annotated, creating ``additionalFragments``.
 - (void)callAllelesAndAdditionalPeak:(BOOL)annotateSuppPeaks;
 
+/// Calls the alleles of several genotypes, as ``callAllelesAndAdditionalPeak:`` does for each genotype, using all CPU cores.
+///
+/// This method reads the ``FluoTrace/annotatedPeaks`` in the range of markers and the marker properties on the current thread,
+/// then identifies alleles on background threads, without accessing managed objects.
+/// The alleles are then modified on the main thread, all at once, before `completionHandler` is called.
+/// Genotypes that were deleted in the meantime, or whose input (annotated peaks in the marker range, marker properties, offset) has changed, are left untouched.
+///
+/// This method must be called on the main thread, and `genotypes` must belong to a context of the main queue.
+/// - Parameters:
+///   - genotypes: The genotypes whose alleles should be called.
+///   - annotateSuppPeaks: Whether additional peaks should be annotated, creating ``additionalFragments``.
+///   - progress: A progress whose `completedUnitCount` is increased by the number of genotypes called.
+///   If the progress is cancelled, no genotype is modified.
+///   - completionHandler: A block called on the main thread. Its argument is `NO` if the call was cancelled.
++ (void)callAllelesOfGenotypes:(NSArray<Genotype *> *)genotypes annotateAdditionalPeaks:(BOOL)annotateSuppPeaks progress:(nullable NSProgress *)progress completionHandler:(void (^)(BOOL completed))completionHandler;
+
+/// Estimates the ``offset`` of genotypes by cross-correlating the fluorescence of their samples against a consensus profile, and sets their ``offsetData``.
+///
+/// Genotypes are grouped by ``marker``. For each marker, the fluorescence of samples in the marker range is resampled on a grid of sizes (ignoring existing offsets),
+/// then shifts relative to the consensus of the group are estimated with ``estimateProfileShifts``.
+/// All this is done in the background, in a context that reads the persistent store, and only the fluorescence levels in the marker range are read.
+/// Shifts are at most half the ``Mmarker/motiveLength`` (and at most 3 bp), and are centered so that a typical sample has no offset.
+/// An offset only has an `intercept` member, its slope being 1.
+///
+/// A genotype keeps its offset if its sample is not sized, if its profile correlates poorly with the consensus,
+/// if its marker has fewer than 3 genotypes in `genotypes`, or if the new offset differs from the current one by less than 0.05 bp.
+///
+/// This method must be called on the main thread, and `genotypes` must belong to a context of the main queue.
+/// The changes of this context must have been written to the persistent store beforehand, so that the background context sees the current sizing of samples.
+/// Genotypes that are deleted before the estimation completes are ignored.
+/// - Parameters:
+///   - genotypes: The genotypes whose offsets should be estimated.
+///   - progress: A progress whose `completedUnitCount` is increased by one each time the profile of a genotype is made.
+///   If the progress is cancelled, no genotype is modified.
+///   - completionHandler: A block called on the main thread. Its argument is `NO` if the estimation was cancelled.
++ (void)estimateOffsetsOfGenotypes:(NSArray<Genotype *> *)genotypes progress:(nullable NSProgress *)progress completionHandler:(void (^)(BOOL completed))completionHandler;
+
+/// Returns whether the genotype may be affected by a change of its ``marker`` or of bins within a range of sizes.
+///
+/// The genotype is affected if one of its ``alleles`` has a peak and a ``LadderFragment/size`` within the range,
+/// or if `checkPeaks` is `YES` and the trace of its sample has a peak whose tip is in the range, considering the ``offset`` of the genotype.
+///
+/// Peaks are found by binary search, hence the cost of this method does not depend on the number of peaks.
+/// - Parameters:
+///   - range: The range of sizes in base pairs.
+///   - checkPeaks: Whether peaks should be considered, in addition to alleles.
+- (BOOL)isAffectedByChangeInRange:(BaseRange)range checkPeaks:(BOOL)checkPeaks;
+
 /// Makes the genotype name its ``alleles`` based on the bins of its marker.
 ///
 /// The method calls ``Allele/findNameFromBins``.
@@ -26,6 +26,8 @@
 #import "PeakLabel.h"
 #import "Allele.h"
 #import "Panel.h"
+#import "StutterStatistics.h"
+#import "OffsetEstimation.h"
 @import Accelerate;
 
 static void * const offsetChangedContext = (void*)&offsetChangedContext;
@@ -47,9 +49,7 @@ static NSPredicate *additionalFragmentPredicate;
 @end
 
 
-@implementation Genotype {
-	BOOL _needsUpdateAlleleUIInfo;
-}
+@implementation Genotype
 
 
 @dynamic alleles, marker, sample, status, notes, offsetData;
@@ -131,14 +131,13 @@ typedef struct MarkerPeak {
 } MarkerPeak;
 
 
-MarkerPeak MarkerPeakFromPeak(Peak peak, const int16_t *fluo, const int16_t *adjustedFluo, const float *sizes, MarkerOffset offset) {
+MarkerPeak MarkerPeakFromAnnotatedPeak(const AnnotatedPeak *peak, MarkerOffset offset) {
 	MarkerPeak markerPeak;
-	int scan = peak.startScan + peak.scansToTip;
-	markerPeak.scan = scan;
-	markerPeak.height = fluo[scan];
-	markerPeak.relativeHeight = adjustedFluo[scan];
-	markerPeak.crossTalk = peak.crossTalk;
-	markerPeak.size = (sizes[scan] - offset.intercept)/offset.slope;
+	markerPeak.scan = peak->scan;
+	markerPeak.height = peak->height;
+	markerPeak.relativeHeight = peak->relativeHeight;
+	markerPeak.crossTalk = peak->crossTalk;
+	markerPeak.size = (peak->size - offset.intercept)/offset.slope;
 	markerPeak.stutterRatio = 0;
 	markerPeak.nChildPeaks = 0;
 	markerPeak.parentPeak = -1;
@@ -146,6 +145,56 @@ MarkerPeak MarkerPeakFromPeak(Peak peak, const int16_t *fluo, const int16_t *adj
 }
 
 
+/// The data needed to call the alleles of a genotype.
+///
+/// This data is read from managed objects beforehand, so that alleles can be called on any thread.
+typedef struct AlleleCallInput {
+	bool canCall;					/// false if the sample is not sized or has no trace for the marker
+	bool annotateSuppPeaks;			/// whether additional peaks should be annotated
+	const AnnotatedPeak *peaks;		/// the annotated peaks of the trace that are in the marker range, which are not copied from the trace
+	int totPeaks;					/// the number of peaks in the marker range
+	int motiveLength;
+	int16_t ploidy;
+	MarkerOffset offset;			/// the offset of the genotype
+	float leftMaxDropOut;			/// The minimum ratio of height to consider an allele that is shorter than a reference one
+	float rightMaxDropOut;			/// The minimum ratio of height to consider an allele that is longer than a reference one
+} AlleleCallInput;
+
+
+/// The result of an allele call, which is applied to the genotype afterwards.
+typedef struct AlleleCall {
+	bool called;					/// false if alleles could not be called, in which case the alleles are left untouched
+	GenotypeStatus status;			/// either genotypeStatusNoPeak or genotypeStatusAutomatic
+	float leftAdenylationRatio;		/// see the corresponding properties of Genotype
+	float rightAdenylationRatio;
+	int scanOfPossibleAllele;
+	int nRetained;					/// the number of peaks considered as alleles
+	int nAdditional;				/// the number of additional peaks
+	MarkerPeak *peaks;				/// the retained peaks (by decreasing height) followed by additional peaks
+} AlleleCall;
+
+
+/// Returns whether two inputs for ``callAlleles`` would yield the same allele call.
+///
+/// As the annotated peaks of a trace are replaced (not modified) when peaks or sizing change,
+/// inputs that point to the same peaks use the same peak data.
+static BOOL alleleCallInputsAreEqual(const AlleleCallInput *input1, const AlleleCallInput *input2) {
+	return input1->canCall == input2->canCall &&
+	input1->annotateSuppPeaks == input2->annotateSuppPeaks &&
+	input1->peaks == input2->peaks &&
+	input1->totPeaks == input2->totPeaks &&
+	input1->motiveLength == input2->motiveLength &&
+	input1->ploidy == input2->ploidy &&
+	input1->offset.intercept == input2->offset.intercept &&
+	input1->offset.slope == input2->offset.slope &&
+	input1->leftMaxDropOut == input2->leftMaxDropOut &&
+	input1->rightMaxDropOut == input2->rightMaxDropOut;
+}
+
+
+void characterizeNeighbors (MarkerPeak *markerPeaks, int nPeaks, int peakIndex, float maxRatio, int motiveLength, bool decreasing);
+
+
 + (NSSet<NSString *> *)keyPathsForValuesAffectingStatusText {
 	return [NSSet setWithObject:@"status"];
 }
@@ -198,63 +247,159 @@ MarkerPeak MarkerPeakFromPeak(Peak peak, const int16_t *fluo, const int16_t *adj
 
 
 - (void)callAllelesAndAdditionalPeak:(BOOL)annotateSuppPeaks {
-	_leftAdenylationRatio = 0;
-	_rightAdenylationRatio = 0;
-	_scanOfPossibleAllele = 0;
+	NSMutableArray *retainedData = NSMutableArray.new;
+	AlleleCallInput input = [self alleleCallInputAnnotatingAdditionalPeaks:annotateSuppPeaks retainingData:retainedData];
+	AlleleCall call = callAlleles(input);
+	[self applyAlleleCall:&call];
+	free(call.peaks);
+}
+
+
++ (void)callAllelesOfGenotypes:(NSArray<Genotype *> *)genotypes annotateAdditionalPeaks:(BOOL)annotateSuppPeaks progress:(nullable NSProgress *)progress completionHandler:(void (^)(BOOL))completionHandler {
+	NSInteger count = genotypes.count;
+	if(count == 0) {
+		completionHandler(YES);
+		return;
+	}
+	
+	/// We read the data needed to call alleles on the current thread, as managed objects cannot be accessed from other threads.
+	/// The data objects are retained, so that the pointers of input structs remain valid even if the attributes of managed objects are replaced.
+	NSMutableArray *retainedData = [NSMutableArray arrayWithCapacity:count];
+	AlleleCallInput *inputs = malloc(count * sizeof(AlleleCallInput));
+	NSInteger index = 0;
+	for(Genotype *genotype in genotypes) {
+		inputs[index++] = [genotype alleleCallInputAnnotatingAdditionalPeaks:annotateSuppPeaks retainingData:retainedData];
+	}
+	
+	AlleleCall *calls = calloc(count, sizeof(AlleleCall));
+	
+	/// Genotypes are called by chunks, to limit the cost of dispatching and of progress updates.
+	NSInteger nChunks = MIN(count, NSProcessInfo.processInfo.activeProcessorCount * 8);
+	NSInteger chunkSize = (count + nChunks - 1) / nChunks;
+	
+	dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+		dispatch_apply(nChunks, DISPATCH_APPLY_AUTO, ^(size_t chunk) {
+			NSInteger start = chunk * chunkSize, end = MIN(count, start + chunkSize);
+			for (NSInteger i = start; i < end; i++) {
+				if(progress.isCancelled) {
+					return;
+				}
+				calls[i] = callAlleles(inputs[i]);
+			}
+			if(progress && end > start) {
+				@synchronized (progress) {
+					progress.completedUnitCount += end - start;
+				}
+			}
+		});
+		
+		dispatch_async(dispatch_get_main_queue(), ^{
+			/// Results are applied serially, as this modifies managed objects. A cancelled call leaves all genotypes untouched.
+			BOOL cancelled = progress.isCancelled;
+			if(!cancelled) {
+				/// The user may have deleted or edited genotypes, markers or samples while alleles were called.
+				/// We only apply results whose input has not changed.
+				NSMutableArray *currentData = NSMutableArray.new;
+				NSInteger index = 0;
+				for(Genotype *genotype in genotypes) {
+					NSInteger i = index++;
+					if(genotype.isDeleted || !genotype.managedObjectContext) {
+						continue;
+					}
+					AlleleCallInput currentInput = [genotype alleleCallInputAnnotatingAdditionalPeaks:annotateSuppPeaks retainingData:currentData];
+					if(alleleCallInputsAreEqual(&currentInput, &inputs[i])) {
+						[genotype applyAlleleCall:&calls[i]];
+					}
+				}
+			}
+			for (NSInteger i = 0; i < count; i++) {
+				free(calls[i].peaks);
+			}
+			free(calls);
+			free(inputs);
+			[retainedData removeAllObjects];		/// the data objects are no longer needed
+			completionHandler(!cancelled);
+		});
+	});
+}
+
+
+/// Returns the data needed to call the alleles of the receiver with ``callAlleles``.
+///
+/// This method must be called on the thread of the receiver's context.
+/// - Parameters:
+///   - annotateSuppPeaks: Whether additional peaks should be annotated.
+///   - retainedData: An array to which the data objects referenced by the returned structure are added.
+///   The caller must keep this array until the allele call is done.
+- (AlleleCallInput)alleleCallInputAnnotatingAdditionalPeaks:(BOOL)annotateSuppPeaks retainingData:(NSMutableArray *)retainedData {
+	AlleleCallInput input = {0};
+	input.annotateSuppPeaks = annotateSuppPeaks;
 	Chromatogram *sample = self.sample;
 	if(sample.sizingQuality.floatValue <= 0) {
 		/// we don't call alleles for a samples that is not sized
-		return;
+		return input;
 	}
 	
 	Mmarker *marker = self.marker;
 	Trace *trace = [sample traceForChannel:marker.channel];
 	if(!trace || !marker) {
-		return;
+		return input;
 	}
 	
-	NSData *peakData = trace.peaks;
-	long totPeaks = peakData.length/sizeof(Peak);
-	if(totPeaks == 0) {
-		for(Allele *allele in self.alleles) {
-			if(!allele.additional) {
-				allele.scan = 0;
-			} else {
-				[allele removeFromGenotypeAndDelete];
-			}
-		}
-		self.status = genotypeStatusNoPeak;
-		return;
+	input.canCall = true;
+	MarkerOffset offset = self.offset;
+	input.offset = offset;
+	/// The annotated peaks are shared by the markers of the trace. We only take the slice of the marker range,
+	/// which is converted to sizes in the trace given the offset, like the sizes of peaks are converted to marker sizes (see `MarkerPeakFromAnnotatedPeak()`).
+	NSData *annotatedPeaks = trace.annotatedPeaks;
+	NSRange peakRange = annotatedPeakRangeForSizes(annotatedPeaks, marker.start * offset.slope + offset.intercept, marker.end * offset.slope + offset.intercept);
+	if(peakRange.length > 0) {
+		[retainedData addObject:annotatedPeaks];
+		input.peaks = (const AnnotatedPeak *)annotatedPeaks.bytes + peakRange.location;
+		input.totPeaks = (int)peakRange.length;
 	}
+	input.motiveLength = marker.motiveLength;
+	input.ploidy = marker.ploidy;
+	input.leftMaxDropOut = 0.7;
+	input.rightMaxDropOut = 0.3;
+	NSData *stutterStatistics = marker.stutterStatistics;
+	if(stutterStatistics) {
+		/// Thresholds are raised at markers that produce strong stutter peaks, so that these are not called as alleles.
+		adjustDropOutRatiosToStutterStatistics(stutterStatistics.bytes, &input.leftMaxDropOut, &input.rightMaxDropOut);
+	}
+	return input;
+}
+
+
+/// Identifies the peaks that represent alleles and additional fragments, without accessing any managed object.
+///
+/// This function can be called on any thread. The `peaks` member of the returned structure must be freed by the caller.
+AlleleCall callAlleles(AlleleCallInput input) {
+	AlleleCall call = {0};
+	if(!input.canCall) {
+		return call;
+	}
+	call.called = true;
+	call.status = genotypeStatusNoPeak;
 	
-	/// we define the range of sizes to select peaks that could be alleles
-	float startSize = self.marker.start;
-	float endSize = self.marker.end;
-	
-	/// we access the fluo levels of the trace
-	NSData *rawData = trace.rawData;
-	NSData *adjustedData = [trace adjustedDataMaintainingPeakHeights:NO];
-	const int16_t *fluo = rawData.bytes;
-	const int16_t *adjustedFluo = adjustedData.bytes;
-	long nScans = rawData.length/sizeof(int16_t);
+	long totPeaks = input.totPeaks;
+	if(totPeaks == 0) {
+		return call;
+	}
 	
-	/// we select peaks in the range. We will first store their height and their indices as we will examine them by decreasing height
-	int *peakIndices = malloc(totPeaks * sizeof(int));	/// The position of peak structs in the peaks attribute of the trace
+	/// we select peaks of the marker range that do not result from crosstalk. We will first store their height and their indices as we will examine them by decreasing height
+	int *peakIndices = malloc(totPeaks * sizeof(int));	/// The position of peak structs in the slice of annotated peaks
 	float *heights = malloc(totPeaks * sizeof(float));	/// The heights of peaks
 
-	int nPeaks = 0;										/// the number of peaks in the range
+	int nPeaks = 0;										/// the number of peaks retained
 	vDSP_Length *markerPeakIndices = malloc(totPeaks * sizeof(vDSP_Length));	/// will be 0..nPeaks
-	const Peak *peaks = peakData.bytes;
+	const AnnotatedPeak *peaks = input.peaks;
 	for(int i = 0; i < totPeaks; i++) {
-		Peak peak = peaks[i];
-		int scan = peak.startScan + peak.scansToTip;
-		float size = [sample sizeForScan:scan];
-		if(size > endSize || scan + peak.scansFromTip >= nScans) {
-			break;
-		} else if(size >= startSize && peak.crossTalk >= 0) {		/// we ignore peaks due to crosstalk
+		const AnnotatedPeak *peak = &peaks[i];
+		if(peak->crossTalk >= 0) {		/// we ignore peaks due to crosstalk
 			peakIndices[nPeaks] = i;
 			markerPeakIndices[nPeaks] = nPeaks;
-			heights[nPeaks] = fluo[scan] + peak.crossTalk * 10e5;	/// as an estimate of height, we actually use the with of the saturated region (if positive) as a first criterion. Then the actual raw fluorescence level, is used as a second criterion
+			heights[nPeaks] = peak->height + peak->crossTalk * 10e5;	/// as an estimate of height, we actually use the with of the saturated region (if positive) as a first criterion. Then the actual raw fluorescence level, is used as a second criterion
 			nPeaks++;
 		}
 	}
@@ -263,29 +408,19 @@ MarkerPeak MarkerPeakFromPeak(Peak peak, const int16_t *fluo, const int16_t *adj
 		free(peakIndices); peakIndices = NULL;
 		free(heights); heights = NULL;
 		free(markerPeakIndices); markerPeakIndices = NULL;
-		for(Allele *allele in self.alleles) {
-			if(!allele.additional) {
-				allele.scan = 0;
-			} else {
-				[allele removeFromGenotypeAndDelete];
-			}
-		}
-		self.status = genotypeStatusNoPeak;
-		return;
+		return call;
 	}
 	
 	/// from now on, the genotype is considered called
-	self.status = genotypeStatusAutomatic;
+	call.status = genotypeStatusAutomatic;
 	
 	/// to contain the peaks to inspect
 	MarkerPeak *markerPeaks = malloc(nPeaks * sizeof(MarkerPeak));
 	
-	MarkerOffset offset = self.offset;
-	NSData *sizeData = sample.sizes;
-	const float *sizes = sizeData.bytes;
+	MarkerOffset offset = input.offset;
 	for(int i = 0; i < nPeaks; i++) {
 		int index = peakIndices[i];
-		markerPeaks[i] = MarkerPeakFromPeak(peaks[index], fluo, adjustedFluo, sizes, offset);
+		markerPeaks[i] = MarkerPeakFromAnnotatedPeak(&peaks[index], offset);
 	}
 	
 	/// as we will inspect the peak by decreasing height, we sort the peak indices according to this criterion
@@ -295,10 +430,10 @@ MarkerPeak MarkerPeakFromPeak(Peak peak, const int16_t *fluo, const int16_t *adj
 	free(heights); heights = NULL;
 	free(peakIndices); peakIndices = NULL;
 	
-	float rightMaxDropOut = 0.3;		/// The minimum ratio of height to consider an allele that is longer than a reference one
-	float leftMaxDropOut = 0.7;			/// The minimum ratio of height to consider an allele that is shorter than a reference one
+	float rightMaxDropOut = input.rightMaxDropOut;
+	float leftMaxDropOut = input.leftMaxDropOut;
 		
-	int motiveLength = marker.motiveLength;
+	int motiveLength = input.motiveLength;
 	
 	for (int i = 0; i < nPeaks; i++) {
 		int index = (int)markerPeakIndices[i];
@@ -319,7 +454,8 @@ MarkerPeak MarkerPeakFromPeak(Peak peak, const int16_t *fluo, const int16_t *adj
 	MarkerPeak **additionalPeakPTRs = malloc(nPeaks * sizeof(MarkerPeak*));
 	int nRetained = 1;					/// number of peaks considered as alleles
 	int nAdditional = 0;
-	int16_t ploidy = marker.ploidy;
+	int16_t ploidy = input.ploidy;
+	bool annotateSuppPeaks = input.annotateSuppPeaks;
 	/// We consider the tallest peak as retained
 	MarkerPeak *lastRetainedPeakPTR = &markerPeaks[markerPeakIndices[0]];
 	retainedPeakPTRs[0] = lastRetainedPeakPTR;
@@ -361,12 +497,12 @@ MarkerPeak MarkerPeakFromPeak(Peak peak, const int16_t *fluo, const int16_t *adj
 				MarkerPeak *parentPeakPTR = &markerPeaks[parentPeak];
 				float diffSize = parentPeakPTR->size - peakPTR->size;
 				if(fabs(diffSize) < 1.5) {
-					if(stutterRatio > _leftAdenylationRatio && stutterRatio > _rightAdenylationRatio) {
-						_scanOfPossibleAllele = peakPTR->scan;
+					if(stutterRatio > call.leftAdenylationRatio && stutterRatio > call.rightAdenylationRatio) {
+						call.scanOfPossibleAllele = peakPTR->scan;
 						if(diffSize > 0) {
-							_leftAdenylationRatio = stutterRatio;
+							call.leftAdenylationRatio = stutterRatio;
 						} else {
-							_rightAdenylationRatio = stutterRatio;
+							call.rightAdenylationRatio = stutterRatio;
 						}
 					}
 				}
@@ -381,11 +517,61 @@ MarkerPeak MarkerPeakFromPeak(Peak peak, const int16_t *fluo, const int16_t *adj
 
 	free(markerPeakIndices); markerPeakIndices = NULL;
 	
+	/// We copy the retained and additional peaks, as the other peaks are no longer needed.
+	call.peaks = malloc((nRetained + nAdditional) * sizeof(MarkerPeak));
+	for (int i = 0; i < nRetained; i++) {
+		call.peaks[i] = *retainedPeakPTRs[i];
+	}
+	for (int i = 0; i < nAdditional; i++) {
+		call.peaks[nRetained + i] = *additionalPeakPTRs[i];
+	}
+	call.nRetained = nRetained;
+	call.nAdditional = nAdditional;
+	
+	free(markerPeaks);
+	free(additionalPeakPTRs);
+	free(retainedPeakPTRs);
+	return call;
+}
+
+
+/// Gives the receiver's alleles the scans and sizes of the peaks identified by ``callAlleles``, and names them.
+- (void)applyAlleleCall:(AlleleCall *)call {
+	_leftAdenylationRatio = call->leftAdenylationRatio;
+	_rightAdenylationRatio = call->rightAdenylationRatio;
+	_scanOfPossibleAllele = call->scanOfPossibleAllele;
+	if(!call->called) {
+		return;
+	}
+	
+	/// Attributes are only set if their value changes, so that recalling a genotype with the same result does not mark objects as updated.
+	if(self.status != call->status) {
+		self.status = call->status;
+	}
+	
+	if(call->status == genotypeStatusNoPeak) {
+		for(Allele *allele in self.alleles) {
+			if(!allele.additional) {
+				if(allele.scan != 0) {
+					allele.scan = 0;
+				}
+			} else {
+				[allele removeFromGenotypeAndDelete];
+			}
+		}
+		return;
+	}
+	
+	int nRetained = call->nRetained;
+	int nAdditional = call->nAdditional;
+	MarkerPeak *retainedPeaks = call->peaks;
+	MarkerPeak *additionalPeaks = call->peaks + nRetained;
+
 	NSMutableSet *remainingFragments = self.additionalFragments.mutableCopy;
 	
 	if(nAdditional > 0) {
 		for (int i = 0; i < nAdditional; i++) {
-			MarkerPeak *peak = additionalPeakPTRs[i];
+			MarkerPeak *peak = &additionalPeaks[i];
 			Allele *closestFragment;	/// We reuse fragments that are the closest to the peak to avoid unnecessary movements of labels if the genotype is shown.
 			int closestDistance = INT_MAX;
 			for(Allele *fragment in remainingFragments) {
@@ -404,11 +590,7 @@ MarkerPeak MarkerPeakFromPeak(Peak peak, const int16_t *fluo, const int16_t *adj
 			} else {
 				[remainingFragments removeObject:closestFragment];
 			}
-			/// Setting the scan also makes the allele compute its size, but since we already know the peak size,
-			/// we can make things faster by avoiding using the normal setter.
-			[closestFragment managedObjectOriginal_setScan:peak->scan];
-			[closestFragment managedObjectOriginal_setSize:peak->size];
-			[closestFragment findNameFromBins];
+			[closestFragment takePeakAtScan:peak->scan size:peak->size];
 		}
 	}
 	
@@ -425,12 +607,12 @@ MarkerPeak MarkerPeakFromPeak(Peak peak, const int16_t *fluo, const int16_t *adj
 	if(nRetained > 0) {
 		for(Allele *allele in self.assignedAlleles) {
 			/// By default, the first marker peak will take the allele. If there is more alleles than peaks, this creates homozygotes.
-			MarkerPeak *closestPeak = retainedPeakPTRs[0];
+			MarkerPeak *closestPeak = &retainedPeaks[0];
 			if(nRetained > 1) {
 				_scanOfPossibleAllele = -1;
 				int closestDistance = INT_MAX;
 				for (int i = 0; i < nRetained; i++) {
-					MarkerPeak *peak = retainedPeakPTRs[i];
+					MarkerPeak *peak = &retainedPeaks[i];
 					if(peak->height >= 0) {
 						/// Peaks that are already assigned to alleles have a negative height (see below).
 						int distance = abs(allele.scan - peak->scan);
@@ -445,14 +627,9 @@ MarkerPeak MarkerPeakFromPeak(Peak peak, const int16_t *fluo, const int16_t *adj
 				}
 			}
 			closestPeak->height = -1;	/// Tells that the peak has been used (not very elegant, but convenient).
-			[allele managedObjectOriginal_setScan:closestPeak->scan];
-			[allele managedObjectOriginal_setSize:closestPeak->size];
-			[allele findNameFromBins];
+			[allele takePeakAtScan:closestPeak->scan size:closestPeak->size];
 		}
 	}
-	free(markerPeaks);
-	free(additionalPeakPTRs);
-	free(retainedPeakPTRs);
 }
 
 
@@ -575,6 +752,49 @@ void characterizeNeighbors (MarkerPeak *markerPeaks, int nPeaks, int peakIndex,
 }
 
 
+- (BOOL)isAffectedByChangeInRange:(BaseRange)range checkPeaks:(BOOL)checkPeaks {
+	float start = range.start, end = range.start + range.len;
+	for(Allele *allele in self.alleles) {
+		if(allele.scan > 0) {
+			float size = allele.size;
+			if(size >= start && size <= end) {
+				return YES;
+			}
+		}
+	}
+	if(!checkPeaks) {
+		return NO;
+	}
+	
+	Chromatogram *sample = self.sample;
+	NSData *peakData = [sample traceForChannel:self.marker.channel].peaks;
+	int nPeaks = (int)(peakData.length / sizeof(Peak));
+	if(nPeaks == 0) {
+		return NO;
+	}
+	
+	/// Allele sizes are corrected by the offset, so we convert the range into sizes of the sample, then into scans.
+	MarkerOffset offset = self.offset;
+	float startScan = [sample fractionalScanForSize:start * offset.slope + offset.intercept];
+	float endScan = [sample fractionalScanForSize:end * offset.slope + offset.intercept];
+	if(startScan < 0) {
+		return NO;
+	}
+	
+	const Peak *peaks = peakData.bytes;
+	int low = 0, high = nPeaks;
+	while(low < high) {
+		int mid = (low + high) / 2;
+		if(peaks[mid].startScan + peaks[mid].scansToTip < startScan) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return low < nPeaks && peaks[low].startScan + peaks[low].scansToTip <= endScan;
+}
+
+
 - (void)binAlleles {
 	BOOL foundAllele = NO;
 	for(Allele *allele in self.alleles) {
@@ -589,24 +809,37 @@ void characterizeNeighbors (MarkerPeak *markerPeaks, int nPeaks, int peakIndex,
 #pragma mark - managing allele properties
 
 
+/// The genotypes whose alleles have changed since the last pass of the run loop, which need to update the alleles they show.
+static NSMutableSet<Genotype *> *genotypesWithChangedAlleles;
+
 - (void)_alleleAttributeDidChange {
-	if(!_needsUpdateAlleleUIInfo) {
-		_needsUpdateAlleleUIInfo = YES;
-		/// We defer the update as allele attributes often change successively
-		[self performSelector:@selector(updateAlleles) withObject:nil afterDelay:0];
+	/// Alleles often change successively, and many genotypes may be called at once,
+	/// so we collect genotypes and update them all in a single deferred call.
+	if(!genotypesWithChangedAlleles) {
+		genotypesWithChangedAlleles = NSMutableSet.new;
+	}
+	if(genotypesWithChangedAlleles.count == 0) {
+		[Genotype performSelector:@selector(updateAllelesOfChangedGenotypes) withObject:nil afterDelay:0];
 	}
+	[genotypesWithChangedAlleles addObject:self];
 }
 
 
--(void)updateAlleles {
-	if(_needsUpdateAlleleUIInfo) {
-		self.assignedAlleles = nil;  /// which triggers UI updates via cocoa bindings
-		self.additionalFragments = nil;
-		_needsUpdateAlleleUIInfo = NO;
++ (void)updateAllelesOfChangedGenotypes {
+	NSSet *genotypes = genotypesWithChangedAlleles.copy;
+	[genotypesWithChangedAlleles removeAllObjects];
+	for(Genotype *genotype in genotypes) {
+		[genotype updateAlleles];
 	}
 }
 
 
+-(void)updateAlleles {
+	self.assignedAlleles = nil;  /// which triggers UI updates via cocoa bindings
+	self.additionalFragments = nil;
+}
+
+
 - (NSSet *)assignedAlleles {
 	if(!_assignedAlleles) {
 		NSSet *alleles = self.alleles;
@@ -874,6 +1107,168 @@ const MarkerOffset MarkerOffsetNone = {0.0, 1.0};
 	return nil;
 }
 
+/// Fills a fluorescence profile of the receiver's trace with ``fillOffsetProfile``, and returns `NO` if the sample is not sized or has no trace for the marker.
+///
+/// The profile has `length` points starting at `startSize`, which are sizes of the sample (the ``offset`` is ignored).
+/// Only the fluorescence levels of the scans covering the profile are read, without baseline subtraction,
+/// which does not matter as profiles are centered by ``estimateProfileShifts``.
+- (BOOL)getOffsetProfile:(float *)profile startSize:(float)startSize length:(int)length {
+	Chromatogram *sample = self.sample;
+	Trace *trace = [sample traceForChannel:self.marker.channel];
+	if(!trace || sample.sizingQuality.floatValue <= 0) {
+		return NO;
+	}
+	/// We only take the scans covering the profile, plus one on each side for interpolation.
+	int firstScan = MAX(0, [sample scanForSize:startSize] - 1);
+	int lastScan = MIN(sample.nScans - 1, [sample scanForSize:startSize + length * OffsetProfileStep] + 1);
+	int count = lastScan - firstScan + 1;
+	if(count < 2) {
+		return NO;
+	}
+	float *sizes = malloc(count * sizeof(float));
+	int16_t *fluo = malloc(count * sizeof(int16_t));
+	[sample getSizes:sizes fromScan:firstScan count:count];
+	[trace getFluoLevels:fluo fromScan:firstScan count:count];
+	fillOffsetProfile(profile, length, startSize, fluo, sizes, count);
+	free(sizes);
+	free(fluo);
+	return YES;
+}
+
+
++ (void)estimateOffsetsOfGenotypes:(NSArray<Genotype *> *)genotypes progress:(nullable NSProgress *)progress completionHandler:(void (^)(BOOL))completionHandler {
+	NSManagedObjectContext *context = genotypes.firstObject.managedObjectContext;
+	if(!context) {
+		completionHandler(YES);
+		return;
+	}
+	NSArray<NSManagedObjectID *> *genotypeIDs = [genotypes valueForKeyPath:@"@unionOfObjects.objectID"];
+	
+	/// Profiles are made in a context that reads the store on a private queue, so that the UI remains responsive.
+	NSManagedObjectContext *backgroundContext = [[NSManagedObjectContext alloc] initWithConcurrencyType:NSPrivateQueueConcurrencyType];
+	backgroundContext.persistentStoreCoordinator = context.persistentStoreCoordinator;
+	backgroundContext.undoManager = nil;
+	
+	[backgroundContext performBlock:^{
+		/// Genotypes are grouped by marker, as each marker has its own consensus profile.
+		NSMapTable<Mmarker *, NSMutableArray<Genotype *> *> *genotypesByMarker = NSMapTable.strongToStrongObjectsMapTable;
+		NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:Genotype.entity.name];
+		request.relationshipKeyPathsForPrefetching = @[@"marker", @"sample", @"sample.traces"];
+		/// Batches keep the number of arguments of the SQL query reasonable.
+		const NSUInteger batchSize = 10000;
+		for (NSUInteger start = 0; start < genotypeIDs.count; start += batchSize) {
+			NSArray *batch = [genotypeIDs subarrayWithRange:NSMakeRange(start, MIN(batchSize, genotypeIDs.count - start))];
+			request.predicate = [NSPredicate predicateWithFormat:@"self IN %@", batch];
+			NSError *error;
+			NSArray<Genotype *> *fetchedGenotypes = [backgroundContext executeFetchRequest:request error:&error];
+			if(!fetchedGenotypes) {
+				NSLog(@"Failed to fetch genotypes: %@", error);
+				[progress cancel];
+				break;
+			}
+			for(Genotype *genotype in fetchedGenotypes) {
+				Mmarker *marker = genotype.marker;
+				if(!marker) {
+					continue;
+				}
+				NSMutableArray *markerGenotypes = [genotypesByMarker objectForKey:marker];
+				if(!markerGenotypes) {
+					markerGenotypes = NSMutableArray.new;
+					[genotypesByMarker setObject:markerGenotypes forKey:marker];
+				}
+				[markerGenotypes addObject:genotype];
+			}
+		}
+		
+		NSMutableArray<NSArray<NSManagedObjectID *> *> *groups = NSMutableArray.new;
+		NSMutableArray<NSMutableData *> *shiftArrays = NSMutableArray.new;
+		NSMutableArray<NSMutableData *> *scoreArrays = NSMutableArray.new;
+		dispatch_group_t group = dispatch_group_create();
+		dispatch_queue_t queue = dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0);
+		
+		for(Mmarker *marker in genotypesByMarker) {
+			if(progress.isCancelled) {
+				break;
+			}
+			NSArray<Genotype *> *markerGenotypes = [genotypesByMarker objectForKey:marker];
+			int nGenotypes = (int)markerGenotypes.count;
+			if(nGenotypes < 3) {
+				progress.completedUnitCount += nGenotypes;
+				continue;
+			}
+			/// Profiles cover the marker range extended by the maximum shift on each side.
+			float maxShift = MIN(3.0, marker.motiveLength / 2.0);
+			int maxLag = MAX(1, (int)(maxShift / OffsetProfileStep));
+			float startSize = marker.start - maxLag * OffsetProfileStep;
+			int length = (int)((marker.end - marker.start) / OffsetProfileStep) + 1 + 2*maxLag;
+			
+			/// Profiles are made on the queue of the context, as they are read from managed objects.
+			/// The progress reports this step, which reads the fluorescence data and takes most of the time.
+			float *profiles = calloc((long)nGenotypes * length, sizeof(float));
+			int index = 0;
+			for(Genotype *genotype in markerGenotypes) {
+				if(progress.isCancelled) {
+					break;
+				}
+				@autoreleasepool {
+					[genotype getOffsetProfile:profiles + (long)index * length startSize:startSize length:length];
+				}
+				index++;
+				progress.completedUnitCount++;
+			}
+			if(progress.isCancelled) {
+				free(profiles);
+				break;
+			}
+			
+			NSMutableData *shiftData = [NSMutableData dataWithLength:nGenotypes * sizeof(float)];
+			NSMutableData *scoreData = [NSMutableData dataWithLength:nGenotypes * sizeof(float)];
+			[groups addObject:[markerGenotypes valueForKeyPath:@"@unionOfObjects.objectID"]];
+			[shiftArrays addObject:shiftData];
+			[scoreArrays addObject:scoreData];
+			
+			dispatch_group_async(group, queue, ^{
+				if(!progress.isCancelled) {
+					estimateProfileShifts(profiles, nGenotypes, length, maxLag, shiftData.mutableBytes, scoreData.mutableBytes);
+				}
+				free(profiles);
+			});
+		}
+		
+		dispatch_group_notify(group, dispatch_get_main_queue(), ^{
+			BOOL cancelled = progress.isCancelled;
+			if(!cancelled) {
+				/// Offsets are set in the same pass of the run loop, hence in a single undo group.
+				for (NSInteger i = 0; i < groups.count; i++) {
+					const float *shifts = shiftArrays[i].bytes;
+					const float *scores = scoreArrays[i].bytes;
+					NSInteger index = 0;
+					for(NSManagedObjectID *genotypeID in groups[i]) {
+						float shift = shifts[index], score = scores[index];
+						index++;
+						if(score < 0.5) {
+							/// The profile does not match the consensus well enough for the shift to be reliable.
+							continue;
+						}
+						/// The genotype may have been deleted in the meantime.
+						Genotype *genotype = [context existingObjectWithID:genotypeID error:nil];
+						if(!genotype || genotype.isDeleted) {
+							continue;
+						}
+						MarkerOffset currentOffset = genotype.offset;
+						if(fabsf(currentOffset.intercept - shift) < 0.05 && currentOffset.slope == 1.0) {
+							continue;
+						}
+						MarkerOffset offset = MakeMarkerOffset(shift, 1.0);
+						genotype.offsetData = [NSData dataWithBytes:&offset length:sizeof(MarkerOffset)];
+					}
+				}
+			}
+			completionHandler(!cancelled);
+		});
+	}];
+}
+
 # pragma mark - copying and archiving
 
 - (NSArray<NSPasteboardType> *)writableTypesForPasteboard:(NSPasteboard *)pasteboard {
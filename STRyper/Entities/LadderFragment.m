@@ -70,7 +70,7 @@ LadderFragmentOffsetKey = @"offset";
 		return  nil;
 	}
 	
-	NSData *fluoData = self.trace.primitiveRawData;
+	NSData *fluoData = self.trace.rawData;
 	if(fluoData) {
 		const int16_t *fluo = fluoData.bytes;
 		long nScans = fluoData.length/sizeof(int16_t);
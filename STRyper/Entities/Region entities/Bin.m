@@ -122,16 +122,19 @@
 
 - (void)setStart:(float)start {
 	/// Like for markers, when a bin is edited, we mark the status of genotypes accordingly
-	if(start != self.start) {
-		[self.marker updateGenotypeStatuses];
+	/// Only alleles whose size is between the previous and new start may change name.
+	float previousStart = self.start;
+	if(start != previousStart) {
+		[self.marker updateGenotypeStatusesInRange:MakeBaseRange(MIN(start, previousStart), fabsf(start - previousStart)) checkPeaks:NO];
 		[self managedObjectOriginal_setStart:start];
 	}
 }
 
 
 - (void)setEnd:(float)end {
-	if(end != self.end) {
-		[self.marker updateGenotypeStatuses];
+	float previousEnd = self.end;
+	if(end != previousEnd) {
+		[self.marker updateGenotypeStatusesInRange:MakeBaseRange(MIN(end, previousEnd), fabsf(end - previousEnd)) checkPeaks:NO];
 		[self managedObjectOriginal_setEnd:end];
 	}
 }
@@ -140,7 +143,7 @@
 - (void)setName:(NSString *)name {
 	if(![name isEqualToString:self.name]) {
 		[self managedObjectOriginal_setName:name];
-		[self.marker updateGenotypeStatuses];
+		[self.marker updateGenotypeStatusesInRange:MakeBaseRange(self.start, self.end - self.start) checkPeaks:NO];
 	}
 }
 
@@ -155,6 +158,15 @@
 }
 
 
+- (void)didChangeValueForKey:(NSString *)key {
+	[super didChangeValueForKey:key];
+	/// This is also called when the range is changed by undo or by merging changes from another context.
+	if([key isEqualToString:@"start"] || [key isEqualToString:@"end"]) {
+		[self.marker _binsDidChange];
+	}
+}
+
+
 + (float)minimumWidth {
 	return 0.1;
 }
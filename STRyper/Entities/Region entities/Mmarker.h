@@ -90,9 +90,18 @@ typedef NS_ENUM(int16_t, Ploidy) {
 
 /// The marker's ``bins`` sorted by ``Region/start`` in ascending order.
 ///
-/// This property is generated dynamically on demand.
+/// This array is generated on demand and kept until ``bins`` are added or removed, or until the range of a bin changes.
 @property (nonatomic, nullable, readonly) NSArray<Bin *> *sortedBins;
 
+/// Returns the bin whose range contains a size, or `nil` if there is none.
+///
+/// This method uses a binary search on the ranges of ``sortedBins``, and does not access the attributes of bins.
+/// - Parameter size: A size in base pairs.
+- (nullable Bin *)binForSize:(float)size;
+
+/// Internal method called after bins are added or removed, or after the range of a bin changes, to reset the ``sortedBins``.
+- (void)_binsDidChange;
+
 /// The genotypes that samples have for the marker.
 ///
 /// This comprises the genotypes of all samples whose ``Chromatogram/panel`` contains the marker.
@@ -137,13 +146,42 @@ typedef NS_ENUM(int16_t, Ploidy) {
 ///   - width: The desired width of the bin in base pairs. It must be at least ``Region/minimumWidth``.
 - (nullable Bin *)insertBinAtSize:(float)midSize desiredWidth:(float)width;
 
+/// Returns bins proposed by clustering the sizes of the alleles found at the marker.
+///
+/// The sizes of the assigned ``Genotype/alleles`` that have a peak (a ``LadderFragment/scan`` greater than 0) are clustered with ``proposedBinsForSizes``, considering the ``motiveLength`` of the marker.
+/// Genotypes of samples that are not sized or whose sizing has changed are ignored.
+///
+/// A cluster must contain at least 0.5% of the sizes (and at least 2 sizes) to yield a bin. Bins that are not fully within the marker range are not returned.
+/// - Returns: An array of ``ProposedBin`` structs, sorted by increasing size.
+- (NSData *)proposedBinsFromAlleleSizes;
+
+/// Statistics on the stutter peaks, adenylation and heterozygote balance of genotypes at the marker, as a ``StutterStatistics`` struct.
+///
+/// These statistics are set by ``computeStutterStatistics`` and are not saved in the store. They are reset when the ``motiveLength`` changes.
+/// When set, they are used to adjust the thresholds of allele calling (see ``adjustDropOutRatiosToStutterStatistics``).
+@property (nonatomic, readonly, nullable) NSData *stutterStatistics;
+
+/// Sets the ``stutterStatistics`` of the marker from its called ``genotypes``.
+///
+/// Ratios are measured in a single pass over genotypes that were called automatically or edited manually, using the ``FluoTrace/annotatedPeaks`` of their samples.
+- (void)computeStutterStatistics;
+
 /// Makes the marker update the ``Genotype/status`` of its `genotypes`.
 ///
 /// The marker calls ``Genotype/setProposedStatus:`` with `GenotypeStatusMarkerChanged`
 /// on each of its ``genotypes``.
-/// This method is called when the  coordinates of the marker change.
+/// This method is called when the ``motiveLength`` of the marker changes.
 -(void) updateGenotypeStatuses;
 
+/// Makes the marker update the ``Genotype/status`` of the ``genotypes`` that are affected by a change within a range of sizes.
+///
+/// This method has the same effect as ``updateGenotypeStatuses``, but only for genotypes that return `YES` to ``Genotype/isAffectedByChangeInRange:checkPeaks:``.
+/// It is called when the coordinates of the marker or of its ``bins`` change, with the range that was added or removed.
+/// - Parameters:
+///   - range: The range of sizes affected by the change.
+///   - checkPeaks: Whether peaks in the range should make a genotype affected, in addition to alleles.
+-(void) updateGenotypeStatusesInRange:(BaseRange)range checkPeaks:(BOOL)checkPeaks;
+
 @end
 
 /// A pasteboard to copy markers.
@@ -167,6 +205,7 @@ extern NSString * _Nonnull const MarkerPanelKey;
 - (void)managedObjectOriginal_setPanel:(Panel *)panel;
 - (void)managedObjectOriginal_setPloidy:(Ploidy)ploidy;
 - (void)managedObjectOriginal_setChannel:(int16_t)channel;
+- (void)managedObjectOriginal_setMotiveLength:(int16_t)motiveLength;
 
 @end
 
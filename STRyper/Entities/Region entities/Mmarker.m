@@ -26,6 +26,8 @@
 #import "Allele.h"
 #import "Genotype.h"
 #import "Chromatogram.h"
+#import "BinClustering.h"
+#import "StutterStatistics.h"
 
 @interface Mmarker ()
 
@@ -35,15 +37,27 @@
 @end
 
 
-@implementation Mmarker
+/// The range of a bin in base pairs, which is used to find bins by binary search.
+typedef struct BinInterval {
+	float start;
+	float end;
+} BinInterval;
+
+
+@implementation Mmarker {
+	/// The bins sorted by start, and their ranges (array of `BinInterval`), in the same order.
+	/// These are set on demand and reset when bins are added, removed, or when their range change.
+	NSArray<Bin *> *_sortedBins;
+	NSData *_binIntervals;
+	NSData *_stutterStatistics;
+}
 
 @dynamic ploidy, channel, motiveLength, bins, panel, genotypes;
-@synthesize channelImage, channelName, visibleRange;
+@synthesize channelImage, channelName, visibleRange, stutterStatistics = _stutterStatistics;
 
 NSString * _Nonnull const MarkerBinsKey = @"bins";
 NSString * _Nonnull const MarkerPanelKey = @"panel";
 NSPasteboardType _Nonnull const MarkerPasteboardType = @"org.jpeccoud.stryper.markerPasteboardType";
-static void * const binsChangedContext = (void*)&binsChangedContext;
 
 
 
@@ -79,12 +93,77 @@ static void * const binsChangedContext = (void*)&binsChangedContext;
 
 
 - (NSArray<Bin *> *)sortedBins {
-	return [self.bins.allObjects sortedArrayUsingComparator:^NSComparisonResult(Bin *bin1, Bin *bin2) {
-		if(bin1.start < bin2.start) {
-			return NSOrderedAscending;
+	if(!_sortedBins) {
+		NSArray<Bin *> *sortedBins = [self.bins.allObjects sortedArrayUsingComparator:^NSComparisonResult(Bin *bin1, Bin *bin2) {
+			if(bin1.start < bin2.start) {
+				return NSOrderedAscending;
+			}
+			return NSOrderedDescending;
+		}];
+		
+		NSMutableData *binIntervals = [NSMutableData dataWithLength:sortedBins.count * sizeof(BinInterval)];
+		BinInterval *intervals = binIntervals.mutableBytes;
+		for(Bin *bin in sortedBins) {
+			*intervals++ = (BinInterval){bin.start, bin.end};
 		}
-		return NSOrderedDescending;
-	}];
+		_binIntervals = binIntervals;
+		_sortedBins = sortedBins;
+	}
+	return _sortedBins;
+}
+
+
+- (nullable Bin *)binForSize:(float)size {
+	NSArray<Bin *> *sortedBins = self.sortedBins;
+	const BinInterval *intervals = _binIntervals.bytes;
+	long nBins = _binIntervals.length / sizeof(BinInterval);
+	if(nBins == 0 || size < intervals[0].start) {
+		return nil;
+	}
+	
+	/// We find the last bin that starts before the size. As bins do not overlap, it is the only one that may contain the size.
+	long low = 0, high = nBins - 1;
+	while(low < high) {
+		long mid = (low + high + 1) / 2;
+		if(intervals[mid].start <= size) {
+			low = mid;
+		} else {
+			high = mid - 1;
+		}
+	}
+	if(size <= intervals[low].end) {
+		return sortedBins[low];
+	}
+	return nil;
+}
+
+
+- (void)_binsDidChange {
+	_sortedBins = nil;
+	_binIntervals = nil;
+}
+
+
+- (void)didChangeValueForKey:(NSString *)key {
+	[super didChangeValueForKey:key];
+	if([key isEqualToString:MarkerBinsKey]) {
+		[self _binsDidChange];
+	}
+}
+
+
+- (void)didChangeValueForKey:(NSString *)inKey withSetMutation:(NSKeyValueSetMutationKind)inMutationKind usingObjects:(NSSet *)inObjects {
+	[super didChangeValueForKey:inKey withSetMutation:inMutationKind usingObjects:inObjects];
+	if([inKey isEqualToString:MarkerBinsKey]) {
+		[self _binsDidChange];
+	}
+}
+
+
+- (void)didTurnIntoFault {
+	[super didTurnIntoFault];
+	[self _binsDidChange];
+	_stutterStatistics = nil;
 }
 
 
@@ -97,22 +176,34 @@ static void * const binsChangedContext = (void*)&binsChangedContext;
 
 
 - (void)setStart:(float)start {
-	/// when these attribute change, we make the user know that the marker has been modified for any genotype generated for this marker
-	if(self.start != start) {
+	/// when these attribute change, we make the user know that the marker has been modified for genotypes that have alleles or peaks
+	/// in the range that is added to or removed from the marker.
+	float previousStart = self.start;
+	if(previousStart != start) {
 		[self managedObjectOriginal_setStart:start];
-		[self updateGenotypeStatuses];
+		[self updateGenotypeStatusesInRange:MakeBaseRange(MIN(start, previousStart), fabsf(start - previousStart)) checkPeaks:YES];
 	}
 }
 
 
 - (void)setEnd:(float)end {		/// see -setStart:
-	if(self.end != end) {
+	float previousEnd = self.end;
+	if(previousEnd != end) {
 		[self managedObjectOriginal_setEnd:end];
-		[self updateGenotypeStatuses];
+		[self updateGenotypeStatusesInRange:MakeBaseRange(MIN(end, previousEnd), fabsf(end - previousEnd)) checkPeaks:YES];
 	}
 }
 
 
+- (void)setMotiveLength:(int16_t)motiveLength {
+	/// The motive length is used to identify stutter peaks during allele calling, so any genotype may be affected.
+	if(self.motiveLength != motiveLength) {
+		[self managedObjectOriginal_setMotiveLength:motiveLength];
+		/// Stutter peaks are no longer at the same positions.
+		_stutterStatistics = nil;
+		[self updateGenotypeStatuses];
+	}
+}
 
 
 -(void) updateGenotypeStatuses {
@@ -125,6 +216,23 @@ static void * const binsChangedContext = (void*)&binsChangedContext;
 }
 
 
+-(void) updateGenotypeStatusesInRange:(BaseRange)range checkPeaks:(BOOL)checkPeaks {
+	NSManagedObjectContext *MOC = self.managedObjectContext;
+	[MOC performBlockAndWait:^{
+		for(Genotype *genotype in self.genotypes) {
+			GenotypeStatus status = genotype.status;
+			if(status == genotypeStatusNotCalled || status == genotypeStatusMarkerChanged) {
+				/// Proposing the status would not change it.
+				continue;
+			}
+			if([genotype isAffectedByChangeInRange:range checkPeaks:checkPeaks]) {
+				genotype.proposedStatus = genotypeStatusMarkerChanged;
+			}
+		}
+	}];
+}
+
+
 - (void)setChannel:(int16_t)channel {
 	[self managedObjectOriginal_setChannel:channel];
 }
@@ -393,6 +501,78 @@ static void * const binsChangedContext = (void*)&binsChangedContext;
 
 }
 
+- (NSData *)proposedBinsFromAlleleSizes {
+	NSSet *genotypes = self.genotypes;
+	NSMutableData *sizeData = [NSMutableData dataWithCapacity:genotypes.count * self.ploidy * sizeof(float)];
+	for(Genotype *genotype in genotypes) {
+		GenotypeStatus status = genotype.status;
+		if(status == genotypeStatusNoSizing || status == genotypeStatusSizingChanged) {
+			continue;
+		}
+		for(Allele *allele in genotype.assignedAlleles) {
+			if(allele.scan > 0) {
+				float size = allele.size;
+				[sizeData appendBytes:&size length:sizeof(size)];
+			}
+		}
+	}
+	
+	long nSizes = sizeData.length / sizeof(float);
+	NSData *bins = proposedBinsForSizes(sizeData.bytes, nSizes, self.motiveLength, MAX(2, nSizes / 200));
+	
+	/// We only retain bins that are in the marker range, as required for validation.
+	NSMutableData *binsInRange = [NSMutableData dataWithCapacity:bins.length];
+	float start = self.start, end = self.end;
+	const ProposedBin *proposedBins = bins.bytes;
+	for (long i = 0; i < bins.length / sizeof(ProposedBin); i++) {
+		if(proposedBins[i].start > start && proposedBins[i].end < end) {
+			[binsInRange appendBytes:&proposedBins[i] length:sizeof(ProposedBin)];
+		}
+	}
+	return binsInRange;
+}
+
+
+- (void)computeStutterStatistics {
+	StutterStatistics *statistics = calloc(1, sizeof(StutterStatistics));
+	int motiveLength = self.motiveLength;
+	float start = self.start, end = self.end;
+	int16_t ploidy = self.ploidy;
+	int32_t alleleScans[MAX(ploidy, 2)];
+	
+	for(Genotype *genotype in self.genotypes) {
+		GenotypeStatus status = genotype.status;
+		if(status != genotypeStatusAutomatic && status != genotypeStatusManual) {
+			continue;
+		}
+		int nAlleles = 0;
+		for(Allele *allele in genotype.assignedAlleles) {
+			if(allele.scan > 0 && nAlleles < ploidy) {
+				alleleScans[nAlleles++] = allele.scan;
+			}
+		}
+		if(nAlleles == 0) {
+			continue;
+		}
+		
+		Trace *trace = [genotype.sample traceForChannel:self.channel];
+		NSData *annotatedPeaks = trace.annotatedPeaks;
+		if(!annotatedPeaks) {
+			continue;
+		}
+		/// The marker range is converted to sizes in the trace, as the genotype may have an offset.
+		MarkerOffset offset = genotype.offset;
+		NSRange peakRange = annotatedPeakRangeForSizes(annotatedPeaks, start * offset.slope + offset.intercept, end * offset.slope + offset.intercept);
+		if(peakRange.length > 0) {
+			const AnnotatedPeak *peaks = (const AnnotatedPeak *)annotatedPeaks.bytes + peakRange.location;
+			addGenotypeToStutterStatistics(statistics, peaks, (int)peakRange.length, alleleScans, nAlleles, motiveLength);
+		}
+	}
+	
+	_stutterStatistics = [NSData dataWithBytesNoCopy:statistics length:sizeof(StutterStatistics) freeWhenDone:YES];
+}
+
+
 #pragma mark - copying and archiving
 
 - (BOOL)isEquivalentTo:(__kindof NSManagedObject *)obj {
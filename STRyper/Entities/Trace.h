@@ -88,8 +88,46 @@ typedef NS_ENUM(int16_t, ChannelNumber) {
 /// The raw fluorescence level for all scans (array of 16-bit integers).
 ///
 /// The number of data point in this array should correspond to the ``Chromatogram/nScans`` value of the ``chromatogram``.
+///
+/// The data is stored in compressed form (see ``encodeFluoData``) and decoded the first time this property is accessed.
+/// The decoded data is retained by the ``DataCache`` until the trace turns into a fault or the cache needs memory, after which it is decoded again when accessed.
+///
+/// If the compressed data is large enough, the database only stores a reference to it, and the data is stored in a blob of the ``BlobStore``.
+///
+/// If the data cannot be read (for instance, if its blob is missing or damaged), this property returns empty data,
+/// and the failure is remembered until the stored data changes.
 @property (nonatomic, readonly) NSData *rawData;
 
+/// Returns the references to blobs of the ``BlobStore`` that the traces of a context use to store their fluorescence data, or `nil` if they could not be fetched.
+///
+/// This method fetches the stored data without instantiating traces, and must be called on the thread of the context.
++ (nullable NSSet<NSData *> *)blobReferencesInContext:(NSManagedObjectContext *)context;
+
+/// Stores the fluorescence data as new traces do, if it was stored by an earlier version of the application (without compression or as a blob), and returns whether the stored data changed.
+///
+/// This method is used to migrate databases, so that the rows of traces only contain references to blobs.
+- (BOOL)compactStoredRawData;
+
+/// Gets the raw fluorescence levels for a range of scans.
+///
+/// The method copies these levels from ``rawData`` if it has been decoded,
+/// and otherwise only decodes the part of the stored data that contains the range, without retaining it.
+/// - Parameters:
+///   - levels: On output, the fluorescence levels. This buffer must hold at least `count` values.
+///   - firstScan: The first scan of the range.
+///   - count: The number of scans in the range. Levels of scans beyond the data are set to 0.
+- (void)getFluoLevels:(int16_t *)levels fromScan:(int)firstScan count:(int)count;
+
+/// Gets the raw fluorescence levels at given scans.
+///
+/// Like ``getFluoLevels:fromScan:count:``, this method does not decode or retain the whole ``rawData`` if it is not decoded already.
+/// It is faster than getting levels scan by scan, as stored data is only located once.
+/// - Parameters:
+///   - levels: On output, the fluorescence levels. This buffer must hold at least `count` values.
+///   - scans: The scans, preferably in ascending order. Levels of scans beyond the data are set to 0.
+///   - count: The number of scans.
+- (void)getFluoLevels:(int16_t *)levels atScans:(const int32_t *)scans count:(int)count;
+
 /// Returns the fluorescence data (array of 16-bit integers) with baseline "noise" removed.
 ///
 /// This can be used to draw fluorescence curves in which peaks stand out more.
@@ -175,6 +213,47 @@ int32_t peakEndScan(const Peak *peakPTR);
 /// - Parameter peak: The peak to insert.
 - (BOOL)insertPeak:(Peak)peak;
 
+/// A structure that describes a ``Peak`` with the properties used for allele calling.
+typedef struct AnnotatedPeak {
+	/// The scan at the tip of the peak.
+	int32_t scan;
+
+	/// The size in base pairs at the tip of the peak, given the sizing of the ``chromatogram``.
+	float size;
+
+	/// The fluorescence level of the ``rawData`` at the tip of the peak.
+	int16_t height;
+
+	/// The fluorescence level at the tip of the peak, with baseline level subtracted.
+	int16_t relativeHeight;
+
+	/// The sum of fluorescence levels of the peak, with baseline level subtracted.
+	float area;
+
+	/// The same member as the `crossTalk` member of the ``Peak`` struct.
+	int32_t crossTalk;
+} AnnotatedPeak;
+
+/// The ``peaks`` of the trace described as ``AnnotatedPeak`` structs, in ascending scan order.
+///
+/// Peaks that end at the last scan of the ``rawData`` are not included, nor are peaks whose tip is outside the
+/// ``Chromatogram/minScan`` – ``Chromatogram/maxScan`` range of the ``chromatogram``, so that peak sizes increase within the array.
+///
+/// This array is computed on demand and kept until the ``peaks`` or the ``Chromatogram/coefs`` of the ``chromatogram`` change.
+/// It can be shared by all markers of the ``channel``, which can obtain their peaks with ``annotatedPeakRangeForSizes``.
+///
+/// This property returns `nil` if the ``chromatogram`` is not sized.
+@property (nonatomic, readonly, nullable) NSData *annotatedPeaks;
+
+/// Returns the range of peaks in an array of ``AnnotatedPeak`` whose size is within a range.
+///
+/// This function uses a binary search, hence assumes that peak sizes increase within the array.
+/// - Parameters:
+///   - annotatedPeaks: An array of annotated peaks, such as ``annotatedPeaks``.
+///   - startSize: The minimum size of peaks to return.
+///   - endSize: The maximum size of peaks to return.
+NSRange annotatedPeakRangeForSizes(NSData *annotatedPeaks, float startSize, float endSize);
+
 #pragma mark - fragments associated with the traces
 
 /// Whether the trace represents the molecular ladder of its ``chromatogram``.
@@ -300,8 +379,7 @@ extern NSString * _Nonnull const previousTraceClassName;
 
 @interface FluoTrace (PrimitiveAccessors)
 
-/// Allows quicker access to the trace ``rawData``, which can be accessed often.
-- (NSData*)primitiveRawData;
+/// Allows quicker access to the trace ``peaks``, which can be accessed often.
 - (NSData*)primitivePeaks;
 
 															
@@ -21,6 +21,9 @@
 
 
 #import "Trace.h"
+#import "FluoDataCodec.h"
+#import "BlobStore.h"
+#import "DataCache.h"
 #import "Chromatogram.h"
 #import "TraceView.h"
 #import "Mmarker.h"
@@ -48,9 +51,11 @@ const BaseRange ZeroBaseRange = {.start = 0, .len = 0};
 /// Fluorescence data (array of 16-bit integers) with baseline "noise" removed.
 /// This attribute can be used to draw fluorescence curves in which peaks stand out more.
 /// This is not a core data attribute.
-@property (nonatomic, readonly, nullable) NSData *adjustedData;
+///
+/// The data is retained by the ``DataCache``, hence the weak reference.
+@property (nonatomic, readonly, nullable, weak) NSData *adjustedData;
 
-@property (nonatomic, readonly, nullable) NSData *adjustedDataMaintainingPeakHeights;
+@property (nonatomic, readonly, nullable, weak) NSData *adjustedDataMaintainingPeakHeights;
 
 @end
 
@@ -58,6 +63,8 @@ const BaseRange ZeroBaseRange = {.start = 0, .len = 0};
 /// to set attributes and relationships that are readonly in the interface file
 
 -(void)managedObjectOriginal_setRawData:(NSData *)rawData;
+/// The stored fluorescence data, which may be encoded by ``encodeFluoData`` or be a reference to a blob of the ``BlobStore``.
+-(NSData *)primitiveRawData;
 -(void)managedObjectOriginal_setChannel:(ChannelNumber)channel;
 -(void)managedObjectOriginal_setChromatogram:(Chromatogram *)sample;
 -(void)managedObjectOriginal_setPeaks:(NSData *)peaks;
@@ -79,13 +86,18 @@ const BaseRange ZeroBaseRange = {.start = 0, .len = 0};
 @implementation Trace {
 	__weak NSData *previousPeaks; /// Used to determined if peaks have changed, to update the ``adjustedData`` attribute in this case..
 	__weak NSData *previousPeaksM; /// Used to determined if peaks have changed, to update the ``adjustedDataMaintainingPeakHeights`` attribute in this case..
+	__weak NSData *previousPeaksA; /// Used to determined if peaks have changed, to update the ``annotatedPeaks`` attribute in this case.
+	__weak NSData *previousCoefs;  /// Used to determined if the sizing of the chromatogram has changed, to update the ``annotatedPeaks``.
+	__weak NSData *previousStoredRawData; /// Used to determined if the stored fluorescence data has changed, to update the decoded ``rawData``.
+	__weak NSData *decodedRawData; /// The decoded ``rawData``, which is retained by the ``DataCache`` so that it can be released when memory is needed.
+	__weak NSData *unreadableStoredRawData; /// Stored fluorescence data that could not be read or decoded (e.g., a missing blob), which we do not try reading again.
 
 }
 
 @dynamic dyeName, channel, isLadder, maxFluo, peaks, peakThreshold, rawData, fragments, chromatogram;
 
 @synthesize  adjustedData = _adjustedData,
-adjustedDataMaintainingPeakHeights = _adjustedDataMaintainingPeakHeights,
+adjustedDataMaintainingPeakHeights = _adjustedDataMaintainingPeakHeights, annotatedPeaks = _annotatedPeaks,
 visibleRange = _visibleRange, topFluoLevel = _topFluoLevel;
 
 
@@ -123,12 +135,175 @@ static BOOL appleSilicon;			/// whether the Mac running the application has an A
 	if(self) {
 		[self managedObjectOriginal_setChromatogram:sample];
 		[self managedObjectOriginal_setChannel:channel];
-		[self managedObjectOriginal_setRawData:rawData];
+		NSData *storedData = storedDataForRawData(rawData);
+		[self managedObjectOriginal_setRawData:storedData];
+		previousStoredRawData = storedData;
+		NSData *decodedData = rawData.copy;
+		[DataCache.sharedCache addData:decodedData category:DataCacheCategoryFluorescence];
+		decodedRawData = decodedData;
 	}
 	return self;
 }
 
 
+/// Returns the data to store in the `rawData` attribute for fluorescence data: the encoded data,
+/// or a reference to a blob containing the encoded data if it is large enough.
+static NSData *storedDataForRawData(NSData *rawData) {
+	NSData *encodedData = encodeFluoData(rawData);
+	if(encodedData.length >= BlobStore.minimumBlobLength) {
+		NSData *reference = [BlobStore.sharedStore referenceForData:encodedData];
+		if(reference) {
+			return reference;
+		}
+	}
+	return encodedData;
+}
+
+
+/// Returns the (possibly encoded) fluorescence data for data stored in the `rawData` attribute, reading it from a blob if needed.
+static NSData *_Nullable fluoDataForStoredData(NSData *_Nullable storedData) {
+	if([BlobStore isBlobReference:storedData]) {
+		return [BlobStore.sharedStore dataForReference:storedData];
+	}
+	return storedData;
+}
+
+
+/// Returns the (possibly encoded) fluorescence data of the trace, or `nil` if it cannot be read.
+///
+/// A failure is remembered until the stored data changes, so that a missing blob is not read (and logged) at each access.
+- (nullable NSData *)readableFluoData {
+	if(self.isFault) {
+		[self willAccessValueForKey:@"rawData"];
+		[self didAccessValueForKey:@"rawData"];
+	}
+	NSData *storedData = self.primitiveRawData;
+	if(!storedData || storedData == unreadableStoredRawData) {
+		return nil;
+	}
+	NSData *fluoData = fluoDataForStoredData(storedData);
+	if(!fluoData) {
+		unreadableStoredRawData = storedData;
+	}
+	return fluoData;
+}
+
+
++ (nullable NSSet<NSData *> *)blobReferencesInContext:(NSManagedObjectContext *)context {
+	NSFetchRequest *request = [NSFetchRequest fetchRequestWithEntityName:Trace.entity.name];
+	request.resultType = NSManagedObjectIDResultType;
+	NSError *error;
+	NSArray<NSManagedObjectID *> *traceIDs = [context executeFetchRequest:request error:&error];
+	if(!traceIDs) {
+		NSLog(@"Failed to fetch trace data: %@", error);
+		return nil;
+	}
+	
+	/// We fetch the stored data by batches, as data stored by earlier versions is not a reference and can be large.
+	NSMutableSet *references = [NSMutableSet setWithCapacity:traceIDs.count];
+	request.resultType = NSDictionaryResultType;
+	request.propertiesToFetch = @[@"rawData"];
+	const NSUInteger batchSize = 1000;
+	for (NSUInteger start = 0; start < traceIDs.count; start += batchSize) {
+		@autoreleasepool {
+			NSArray *batch = [traceIDs subarrayWithRange:NSMakeRange(start, MIN(batchSize, traceIDs.count - start))];
+			request.predicate = [NSPredicate predicateWithFormat:@"self IN %@", batch];
+			NSArray<NSDictionary *> *results = [context executeFetchRequest:request error:&error];
+			if(!results) {
+				NSLog(@"Failed to fetch trace data: %@", error);
+				return nil;
+			}
+			for(NSDictionary *result in results) {
+				NSData *storedData = result[@"rawData"];
+				if([BlobStore isBlobReference:storedData]) {
+					[references addObject:storedData];
+				}
+			}
+		}
+	}
+	return references;
+}
+
+
+- (NSData *)rawData {
+	if(self.isFault) {
+		[self willAccessValueForKey:@"rawData"];
+		[self didAccessValueForKey:@"rawData"];
+	}
+	NSData *storedData = self.primitiveRawData;
+	NSData *rawData = decodedRawData;
+	if(storedData != previousStoredRawData || !rawData) {
+		/// Fluorescence data imported before encoding was introduced is not encoded, in which case it is returned as is.
+		previousStoredRawData = storedData;
+		NSData *fluoData = self.readableFluoData;
+		rawData = fluoData? decodeFluoData(fluoData) : nil;
+		if(!rawData) {
+			/// A damaged trace has no fluorescence data, and is therefore not drawn nor analyzed.
+			if(storedData) {
+				unreadableStoredRawData = storedData;
+			}
+			decodedRawData = nil;
+			return NSData.data;
+		}
+		if(rawData != storedData) {
+			/// Data that is the attribute itself is already retained by the trace.
+			[DataCache.sharedCache addData:rawData category:DataCacheCategoryFluorescence];
+		}
+		decodedRawData = rawData;
+	} else {
+		[DataCache.sharedCache useData:rawData];
+	}
+	return rawData;
+}
+
+
+- (BOOL)compactStoredRawData {
+	if(self.isFault) {
+		[self willAccessValueForKey:@"rawData"];
+		[self didAccessValueForKey:@"rawData"];
+	}
+	NSData *storedData = self.primitiveRawData;
+	if(!storedData || [BlobStore isBlobReference:storedData]) {
+		return NO;
+	}
+	NSData *newData = storedDataForRawData(storedData);
+	if(newData == storedData) {
+		/// The data is already encoded and too small for the blob store, or could not be written to it.
+		return NO;
+	}
+	[self managedObjectOriginal_setRawData:newData];
+	return YES;
+}
+
+
+- (void)getFluoLevels:(int16_t *)levels fromScan:(int)firstScan count:(int)count {
+	NSData *rawData = decodedRawData;
+	if(rawData && previousStoredRawData == self.primitiveRawData) {
+		getFluoLevelsFromFluoData(rawData, levels, firstScan, count);
+		return;
+	}
+	NSData *fluoData = self.readableFluoData;
+	if(fluoData) {
+		getFluoLevelsFromFluoData(fluoData, levels, firstScan, count);
+	} else {
+		memset(levels, 0, count * sizeof(int16_t));
+	}
+}
+
+
+- (void)getFluoLevels:(int16_t *)levels atScans:(const int32_t *)scans count:(int)count {
+	NSData *fluoData = decodedRawData;
+	if(!fluoData || previousStoredRawData != self.primitiveRawData) {
+		fluoData = self.readableFluoData;
+	}
+	if(fluoData) {
+		getFluoLevelsAtScansFromFluoData(fluoData, scans, count, levels);
+	} else {
+		memset(levels, 0, count * sizeof(int16_t));
+	}
+}
+
+
 #pragma mark - methods and function related to fluorescence analysis
 
 
@@ -162,6 +337,10 @@ int32_t peakEndScan(const Peak *peakPTR) {
 - (void)findPeaks {
 	NSData *rawData = self.rawData;
 	int nScans = (int)rawData.length / sizeof(int16_t);
+	if(nScans == 0) {
+		/// The fluorescence data could not be read. We keep the peaks that were found before.
+		return;
+	}
 	int16_t peakThreshold = self.peakThreshold;
 	float ratio = 0.7;  							/// ratio of minimum fluo next to peak / peak height.
 	int maxFluoLevel = 0;   						/// the max fluo level of a trace
@@ -255,18 +434,124 @@ int32_t peakEndScan(const Peak *peakPTR) {
 
 
 - (NSData*)adjustedData {
-	if(!_adjustedData || previousPeaks != self.primitivePeaks) {
-		_adjustedData = [self fluoDataWithSubtractedBaselineMaintainingPeakHeight:NO];
+	NSData *adjustedData = _adjustedData;
+	if(!adjustedData || previousPeaks != self.primitivePeaks) {
+		adjustedData = [self fluoDataWithSubtractedBaselineMaintainingPeakHeight:NO];
+		if(adjustedData) {
+			[DataCache.sharedCache addData:adjustedData category:DataCacheCategoryAdjustedFluorescence];
+		}
+		_adjustedData = adjustedData;
+	} else {
+		[DataCache.sharedCache useData:adjustedData];
 	}
-	return _adjustedData;
+	return adjustedData;
 }
 
 
 - (NSData *)adjustedDataMaintainingPeakHeights {
-	if(!_adjustedDataMaintainingPeakHeights || previousPeaksM != self.primitivePeaks) {
-		_adjustedDataMaintainingPeakHeights = [self fluoDataWithSubtractedBaselineMaintainingPeakHeight:YES];
+	NSData *adjustedData = _adjustedDataMaintainingPeakHeights;
+	if(!adjustedData || previousPeaksM != self.primitivePeaks) {
+		adjustedData = [self fluoDataWithSubtractedBaselineMaintainingPeakHeight:YES];
+		if(adjustedData) {
+			[DataCache.sharedCache addData:adjustedData category:DataCacheCategoryAdjustedFluorescence];
+		}
+		_adjustedDataMaintainingPeakHeights = adjustedData;
+	} else {
+		[DataCache.sharedCache useData:adjustedData];
 	}
-	return _adjustedDataMaintainingPeakHeights;
+	return adjustedData;
+}
+
+
+- (nullable NSData *)annotatedPeaks {
+	Chromatogram *sample = self.chromatogram;
+	NSData *coefs = sample.coefs;
+	if(!coefs) {
+		[sample computeFitting];
+		coefs = sample.coefs;
+		if(!coefs) {
+			return nil;
+		}
+	}
+	NSData *peakData = self.primitivePeaks;
+	if(_annotatedPeaks && previousPeaksA == peakData && previousCoefs == coefs) {
+		return _annotatedPeaks;
+	}
+	previousPeaksA = peakData;
+	previousCoefs = coefs;
+	/// Piecewise sizing functions are set with the coefs, so the coefs suffice to detect sizing changes.
+	NSData *segments = sample.sizingSegments;
+	BOOL piecewise = segments.length >= sizeof(SizingSegment);
+	
+	NSData *rawData = self.rawData;
+	NSData *adjustedData = [self adjustedDataMaintainingPeakHeights:NO];
+	int nPeaks = (int)(peakData.length / sizeof(Peak));
+	long nScans = rawData.length / sizeof(int16_t);
+	const Peak *peaks = peakData.bytes;
+	const int16_t *fluo = rawData.bytes;
+	const int16_t *adjustedFluo = adjustedData.bytes;
+	
+	/// Sizes only increase between these scans, so peaks outside them would break the order of sizes, on which ``annotatedPeakRangeForSizes`` relies.
+	int minScan = sample.minScan, maxScan = sample.maxScan;
+	
+	NSMutableData *annotatedPeakData = [NSMutableData dataWithLength:nPeaks * sizeof(AnnotatedPeak)];
+	AnnotatedPeak *annotatedPeaks = annotatedPeakData.mutableBytes;
+	int nAnnotated = 0;
+	for (int i = 0; i < nPeaks; i++) {
+		Peak peak = peaks[i];
+		int scan = peak.startScan + peak.scansToTip;
+		int endScan = scan + peak.scansFromTip;
+		if(endScan >= nScans || scan > maxScan) {
+			/// Peaks are sorted, so no other peak can be annotated.
+			break;
+		}
+		if(scan < minScan) {
+			continue;
+		}
+		float area = 0;
+		for (int j = peak.startScan; j <= endScan; j++) {
+			area += adjustedFluo[j];
+		}
+		annotatedPeaks[nAnnotated++] = (AnnotatedPeak){
+			.scan = scan,
+			.size = piecewise? sizeGivenSegments(scan, segments) : sizeGivenCoefs(scan, coefs),
+			.height = fluo[scan],
+			.relativeHeight = adjustedFluo[scan],
+			.area = area,
+			.crossTalk = peak.crossTalk
+		};
+	}
+	annotatedPeakData.length = nAnnotated * sizeof(AnnotatedPeak);
+	_annotatedPeaks = annotatedPeakData.copy;
+	return _annotatedPeaks;
+}
+
+
+NSRange annotatedPeakRangeForSizes(NSData *annotatedPeaks, float startSize, float endSize) {
+	const AnnotatedPeak *peaks = annotatedPeaks.bytes;
+	long nPeaks = annotatedPeaks.length / sizeof(AnnotatedPeak);
+	
+	/// We find the first peak whose size is not lower than the start size, then the first whose size exceeds the end size.
+	long low = 0, high = nPeaks;
+	while(low < high) {
+		long mid = (low + high) / 2;
+		if(peaks[mid].size < startSize) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	long first = low;
+	high = nPeaks;
+	while(low < high) {
+		long mid = (low + high) / 2;
+		if(peaks[mid].size <= endSize) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return NSMakeRange(first, low - first);
 }
 
 
@@ -277,8 +562,8 @@ int32_t peakEndScan(const Peak *peakPTR) {
 	} else {
 		previousPeaks = peakData;
 	}
-	NSData *fluoData =  self.primitiveRawData;
-	if(!fluoData) {
+	NSData *fluoData =  self.rawData;
+	if(fluoData.length == 0) {
 		return nil;
 	}
 	if(peakData) {
@@ -305,7 +590,7 @@ int32_t peakEndScan(const Peak *peakPTR) {
 
 
 - (int16_t)fluoForScan:(int)scan useRawData:(BOOL)useRawData maintainPeakHeights:(BOOL)maintainPeakHeights {
-	NSData *fluoData = useRawData? self.primitiveRawData : [self adjustedDataMaintainingPeakHeights: maintainPeakHeights];
+	NSData *fluoData = useRawData? self.rawData : [self adjustedDataMaintainingPeakHeights: maintainPeakHeights];
 	if(scan < 0 || scan >= fluoData.length/sizeof(int16_t)) {
 		return 0;
 	}
@@ -551,7 +836,7 @@ void subtractBaselineInRange(const int16_t *inputData, int16_t *outputData, int
 						continue;
 					}
 					/// We get the max fluo level across other traces
-					NSData *traceData = trace.primitiveRawData;
+					NSData *traceData = trace.rawData;
 					if(traceData.length/sizeof(int16_t) >= endScan) {
 						const int16_t *data = traceData.bytes;
 						int16_t rawFluo = data[scan];
@@ -692,7 +977,7 @@ void subtractBaselineInRange(const int16_t *inputData, int16_t *outputData, int
 
 - (Peak)missingPeakForScan:(int)scan useRawData:(BOOL)useRawData {
 	Peak nullPeak = MakePeak(0, 0, 0, 0);
-	NSData *fluoData = useRawData? self.primitiveRawData : self.adjustedData;
+	NSData *fluoData = useRawData? self.rawData : self.adjustedData;
 	const int16_t *fluo = fluoData.bytes;
 	long nScans = fluoData.length/sizeof(int16_t);
 	if(scan >= nScans) {
@@ -845,18 +1130,15 @@ void subtractBaselineInRange(const int16_t *inputData, int16_t *outputData, int
 - (void)prepareDrawPathFromSize:(float)startSize toSize:(float)endSize vScale:(CGFloat)vScale hScale:(CGFloat)hScale leftOffset:(float)leftOffset useRawData:(BOOL)useRawData maintainPeakHeights:(BOOL)maintainPeakHeights minY:(CGFloat)minY {
 		
 	Chromatogram *sample = self.chromatogram;
-	NSData *fluoData = useRawData? self.primitiveRawData : [self adjustedDataMaintainingPeakHeights:maintainPeakHeights];
+	NSData *fluoData = useRawData? self.rawData : [self adjustedDataMaintainingPeakHeights:maintainPeakHeights];
 	const int16_t *fluo = fluoData.bytes;
 	long nRecordedScans = fluoData.length/sizeof(int16_t);
 
-	NSData *sizeData = sample.sizes;
-	long nScanWithSizes = sizeData.length/sizeof(float);
-	if(nScanWithSizes < nRecordedScans) {
-		/// this would indicate an error.
+	if(sample.coefs.length == 0 || sample.nScans < nRecordedScans || nRecordedScans == 0) {
+		/// this would indicate an error, or that the fluorescence data could not be read (a damaged trace is not drawn).
+		pointCount = 0;
 		return;
 	}
-
-	const float	*sizes = sizeData.bytes;
 		
 	/// we never draw scans that are after the maxScan, as they have lower sizes than the maxScan.
 	/// The curve would go back to the left and overlap itself
@@ -864,6 +1146,14 @@ void subtractBaselineInRange(const int16_t *inputData, int16_t *outputData, int
 		
 	/// the first scan for which me may draw the fluorescence is the before the startSize
 	int	startScan = MIN(maxScan, MAX(sample.minScan, [sample scanForSize:startSize]-1));
+	
+	/// We only get sizes for the scans we may draw. The last one is after the endSize.
+	int endScan = MIN(maxScan, (int)ceilf([sample fractionalScanForSize:endSize]) + 1);
+	if(endScan < startScan) {
+		endScan = startScan;
+	}
+	float *sizes = malloc((endScan - startScan + 1) * sizeof(float));	/// sizes[0] is the size at startScan
+	[sample getSizes:sizes fromScan:startScan count:endScan - startScan + 1];
 		
 	size_t maxPointsInCurve = 40;
 	CGPoint *pointArray = NULL;
@@ -887,7 +1177,7 @@ void subtractBaselineInRange(const int16_t *inputData, int16_t *outputData, int
 	}
 	
 	/// We add the first point to draw to the array
-	CGFloat lastX = (sizes[startScan] - leftOffset)*hScale;
+	CGFloat lastX = (sizes[0] - leftOffset)*hScale;
 	CGFloat y = fluo[startScan]*vScale;
 	if (y < minY) {
 		y = minY -1;
@@ -899,15 +1189,15 @@ void subtractBaselineInRange(const int16_t *inputData, int16_t *outputData, int
 	BOOL outside = NO;			/// whether a scan is after maxSize. Used to determine when to stop drawing.
 	int scan = startScan+1;
 	
-	while(!outside && scan <= maxScan) {
-		float size = sizes[scan];
+	while(!outside && scan <= endScan) {
+		float size = sizes[scan - startScan];
 		if(size > endSize) {
 			outside = YES;
 		}
 		CGFloat x = (size - leftOffset) * hScale;
 		
 		int16_t scanFluo = fluo[scan];
-		if (scan < maxScan) {
+		if (scan < endScan) {
 			/// we may skip a point that is too close from previously drawn scans and not a local minimum / maximum
 			/// or that is lower than the fluo threshold
 			int16_t previousFluo = fluo[scan-1];
@@ -932,7 +1222,7 @@ void subtractBaselineInRange(const int16_t *inputData, int16_t *outputData, int
 		
 		CGPoint point = CGPointMake(x, y);
 		pointArray[pointCount++] = point;
-		if((pointCount == maxPointsInCurve || outside || scan == maxScan)) {
+		if((pointCount == maxPointsInCurve || outside || scan == endScan)) {
 			if(useCGPath) {
 				CGPathAddLines(path, NULL, pointArray, pointCount);
 				pointArray[0] = point; /// The first point of the next subpath is the last point of the previous one.
@@ -945,6 +1235,7 @@ void subtractBaselineInRange(const int16_t *inputData, int16_t *outputData, int
 		
 		scan++;
 	}
+	free(sizes);
 }
 
 
@@ -952,7 +1243,7 @@ void subtractBaselineInRange(const int16_t *inputData, int16_t *outputData, int
 - (void)drawCrosstalkPeaksInContext:(CGContextRef)ctx FromSize:(float)startSize toSize:(float)endSize vScale:(float)vScale hScale:(float)hScale leftOffset:(float)leftOffset useRawData:(BOOL)useRawData maintainPeakHeights:(BOOL)maintainPeakHeights offScaleColors:(NSArray<NSColor *> *)offScaleColors {
 	
 	Chromatogram *sample = self.chromatogram;
-	NSData *fluoData = useRawData? self.primitiveRawData : [self adjustedDataMaintainingPeakHeights:maintainPeakHeights];
+	NSData *fluoData = useRawData? self.rawData : [self adjustedDataMaintainingPeakHeights:maintainPeakHeights];
 	const int16_t *fluo = fluoData.bytes;
 	long nRecordedScans = fluoData.length/sizeof(int16_t);
 
@@ -1058,6 +1349,11 @@ void subtractBaselineInRange(const int16_t *inputData, int16_t *outputData, int
 - (instancetype)initWithCoder:(NSCoder *)coder {
 	self = [super initWithCoder:coder];
 	if(self) {
+		/// Archives contain decoded fluorescence data, which we store as for imported traces.
+		NSData *rawData = self.primitiveRawData;
+		if(rawData) {
+			[self managedObjectOriginal_setRawData:storedDataForRawData(rawData)];
+		}
 		self.fragments = [coder decodeObjectOfClasses:[NSSet setWithObjects:NSSet.class, LadderFragment.class, nil]  forKey:@"fragments"];
 	}
 	return self;
@@ -1065,6 +1361,8 @@ void subtractBaselineInRange(const int16_t *inputData, int16_t *outputData, int
 
 - (id)copy {
 	Trace *copy = super.copy;
+	/// The copy can share the stored fluorescence data, rather than the decoded data it got from its attributes.
+	[copy managedObjectOriginal_setRawData:self.primitiveRawData];
 	if(copy.isLadder) {
 		copy.fragments = [[NSSet alloc] initWithSet:self.fragments copyItems:YES];
 	}
@@ -1072,12 +1370,29 @@ void subtractBaselineInRange(const int16_t *inputData, int16_t *outputData, int
 }
 
 
+- (void)prepareForDeletion {
+	[super prepareForDeletion];
+	/// The blob of our fluorescence data may no longer be referenced. We don't check if we have one, as it could fire a fault.
+	[BlobStore.sharedStore setNeedsCollection];
+}
+
+
 - (void)didTurnIntoFault {
 		[super didTurnIntoFault];
+		/// The data we computed is no longer needed.
+		DataCache *cache = DataCache.sharedCache;
+		[cache removeData:_adjustedData];
+		[cache removeData:_adjustedDataMaintainingPeakHeights];
+		[cache removeData:decodedRawData];
 		_adjustedData = nil;
 		_adjustedDataMaintainingPeakHeights = nil;
+		_annotatedPeaks = nil;
 		previousPeaks = nil;
 		previousPeaksM = nil;
+		previousPeaksA = nil;
+		previousCoefs = nil;
+		previousStoredRawData = nil;
+		decodedRawData = nil;
 }
 
 
@@ -0,0 +1,76 @@
+//
+//  BinClustering.h
+//  STRyper
+//
+//  Created by Jean Peccoud on 18/10/2026.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+@import Foundation;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Flags that describe why a bin proposed by ``proposedBinsForSizes`` may need to be checked by the user.
+typedef NS_OPTIONS(int32_t, ProposedBinIssue) {
+	/// Denotes that the bin has no issue.
+	ProposedBinIssueNone = 0,
+
+	/// Denotes that sizes of the cluster spread over more than half the repeat length, hence that the cluster may comprise several alleles.
+	ProposedBinIssueWide = 1 << 0,
+
+	/// Denotes that the cluster is not separated from the main clusters by a multiple of the repeat length.
+	ProposedBinIssueOffPeriod = 1 << 1,
+
+	/// Denotes that the bin was narrowed to avoid overlapping a neighboring bin.
+	ProposedBinIssueCrowded = 1 << 2
+};
+
+/// A bin proposed from a cluster of allele sizes.
+typedef struct ProposedBin {
+	/// The start of the bin in base pairs.
+	float start;
+
+	/// The end of the bin in base pairs.
+	float end;
+
+	/// The median size of the cluster in base pairs.
+	float center;
+
+	/// The number of sizes in the cluster.
+	int32_t count;
+
+	/// The issues found for the cluster.
+	ProposedBinIssue issues;
+} ProposedBin;
+
+
+/// Clusters allele sizes and returns bins corresponding to clusters.
+///
+/// Sizes are counted in a histogram of 0.05-bp cells, which takes linear time.
+/// Clusters are runs of non-empty cells, which are split at valleys whose height is less than a fifth of the peaks on either side.
+///
+/// The width of a bin is derived from the spread between the 5th and 95th percentiles of its cluster, and is at most the repeat length minus 0.2 bp.
+/// Bins are adjusted so that they are separated by at least 0.1 bp.
+///
+/// The bins are reported with the ``ProposedBinIssue`` that may apply to them, so that the user can check ambiguous clusters.
+/// - Parameters:
+///   - sizes: The allele sizes in base pairs. Sizes that are not in the 0 - `MAX_TRACE_LENGTH` range are ignored.
+///   - nSizes: The number of sizes.
+///   - motiveLength: The length of the repeat motive in base pairs.
+///   - minCount: The minimum number of sizes that a cluster must have to yield a bin.
+/// - Returns: An array of ``ProposedBin`` structs, sorted by increasing size.
+NSData *proposedBinsForSizes(const float *sizes, long nSizes, int motiveLength, long minCount);
+
+NS_ASSUME_NONNULL_END
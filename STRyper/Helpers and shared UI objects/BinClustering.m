@@ -0,0 +1,201 @@
+//
+//  BinClustering.m
+//  STRyper
+//
+//  Created by Jean Peccoud on 18/10/2026.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#import "BinClustering.h"
+#import "Chromatogram.h"
+
+/// The width of histogram cells in base pairs.
+static const float cellWidth = 0.05;
+
+/// A cluster is split at a valley whose height is lower than this ratio times the peaks on either side.
+static const float valleyRatio = 0.2;
+
+/// The minimum separation between bins, and the margin added to the spread of a cluster, in base pairs.
+static const float binMargin = 0.1;
+
+
+/// Returns the index of the cell at which the cumulative count of a cluster reaches a fraction of its total count.
+static int quantileCell(const int32_t *counts, int firstCell, int lastCell, int32_t total, float fraction) {
+	int64_t target = ceilf(total * fraction);
+	int64_t cumul = 0;
+	for (int cell = firstCell; cell <= lastCell; cell++) {
+		cumul += counts[cell];
+		if(cumul >= target) {
+			return cell;
+		}
+	}
+	return lastCell;
+}
+
+
+/// Appends a bin for the cluster of cells in the range `firstCell` - `lastCell`, if it has enough sizes.
+static void addCluster(NSMutableData *bins, const int32_t *counts, int firstCell, int lastCell, float histStart, long minCount) {
+	int32_t total = 0;
+	for (int cell = firstCell; cell <= lastCell; cell++) {
+		total += counts[cell];
+	}
+	if(total < minCount || total == 0) {
+		return;
+	}
+
+	/// Sizes are located at the middle of their cells.
+	float center = histStart + (quantileCell(counts, firstCell, lastCell, total, 0.5) + 0.5) * cellWidth;
+	float low = histStart + (quantileCell(counts, firstCell, lastCell, total, 0.05) + 0.5) * cellWidth;
+	float high = histStart + (quantileCell(counts, firstCell, lastCell, total, 0.95) + 0.5) * cellWidth;
+	float halfWidth = MAX(center - low, high - center) + binMargin;
+
+	ProposedBin bin = {.start = center - halfWidth, .end = center + halfWidth, .center = center, .count = total, .issues = ProposedBinIssueNone};
+	[bins appendBytes:&bin length:sizeof(bin)];
+}
+
+
+NSData *proposedBinsForSizes(const float *sizes, long nSizes, int motiveLength, long minCount) {
+	NSMutableData *binData = NSMutableData.new;
+	if(nSizes <= 0 || motiveLength < 1) {
+		return binData;
+	}
+
+	/// We determine the range of the histogram
+	float minSize = MAX_TRACE_LENGTH, maxSize = 0;
+	for (long i = 0; i < nSizes; i++) {
+		float size = sizes[i];
+		if(size >= 0 && size <= MAX_TRACE_LENGTH) {
+			if(size < minSize) {
+				minSize = size;
+			}
+			if(size > maxSize) {
+				maxSize = size;
+			}
+		}
+	}
+	if(maxSize < minSize) {
+		return binData;
+	}
+
+	/// The histogram has an empty cell at each end, so that smoothing and cluster detection need no bound check.
+	float histStart = floorf(minSize) - cellWidth;
+	int nCells = (int)((maxSize - histStart) / cellWidth) + 3;
+	int32_t *counts = calloc(nCells, sizeof(int32_t));
+	for (long i = 0; i < nSizes; i++) {
+		float size = sizes[i];
+		if(size >= 0 && size <= MAX_TRACE_LENGTH) {
+			counts[(int)((size - histStart) / cellWidth)]++;
+		}
+	}
+
+	/// We smooth the histogram over 3 cells, so that sparse cells do not create spurious valleys.
+	float *density = calloc(nCells, sizeof(float));
+	for (int cell = 1; cell < nCells-1; cell++) {
+		density[cell] = counts[cell-1] + counts[cell] + counts[cell+1];
+	}
+
+	/// We delimit clusters. A cluster ends at an empty cell or at a deep enough valley.
+	int clusterStart = -1;
+	float peak = 0, valley = 0;
+	int valleyCell = -1;					/// the cell of lowest density since the last peak, -1 if density has not decreased since the peak.
+	for (int cell = 0; cell < nCells; cell++) {
+		float value = density[cell];
+		if(value == 0) {
+			if(clusterStart >= 0) {
+				addCluster(binData, counts, clusterStart, cell-1, histStart, minCount);
+				clusterStart = -1;
+			}
+			continue;
+		}
+		if(clusterStart < 0) {
+			clusterStart = cell;
+			peak = value;
+			valleyCell = -1;
+			continue;
+		}
+		if(valleyCell >= 0 && valley < valleyRatio * MIN(peak, value)) {
+			/// The density rises again after a deep valley: the valley separates two clusters.
+			addCluster(binData, counts, clusterStart, valleyCell-1, histStart, minCount);
+			clusterStart = valleyCell;
+			peak = 0;
+			for (int i = valleyCell; i <= cell; i++) {
+				peak = MAX(peak, density[i]);
+			}
+			valleyCell = -1;
+		}
+		if(value >= peak) {
+			peak = value;
+			valleyCell = -1;
+		} else if(valleyCell < 0 || value < valley) {
+			valley = value;
+			valleyCell = cell;
+		}
+	}
+
+	free(density);
+	free(counts);
+
+	long nBins = binData.length / sizeof(ProposedBin);
+	if(nBins == 0) {
+		return binData;
+	}
+	ProposedBin *bins = binData.mutableBytes;
+
+	/// We estimate the phase of the repeat period from the clusters that are not wide, weighting them by their number of sizes.
+	/// The phase is the circular mean of cluster centers modulo the motive length.
+	double sumSin = 0, sumCos = 0;
+	for (long i = 0; i < nBins; i++) {
+		if(bins[i].end - bins[i].start - 2*binMargin > motiveLength / 2.0) {
+			bins[i].issues |= ProposedBinIssueWide;
+		} else {
+			double angle = 2 * M_PI * bins[i].center / motiveLength;
+			sumSin += bins[i].count * sin(angle);
+			sumCos += bins[i].count * cos(angle);
+		}
+	}
+
+	if(motiveLength > 1 && (sumSin != 0 || sumCos != 0)) {
+		double phase = atan2(sumSin, sumCos) * motiveLength / (2 * M_PI);
+		for (long i = 0; i < nBins; i++) {
+			double shift = fmod(bins[i].center - phase, motiveLength);
+			if(shift < 0) {
+				shift += motiveLength;
+			}
+			if(MIN(shift, motiveLength - shift) > 0.35) {
+				bins[i].issues |= ProposedBinIssueOffPeriod;
+			}
+		}
+	}
+
+	/// We limit bin widths, then separate bins that are too close, at mid distance between their centers.
+	float maxHalfWidth = MAX(0.25, (motiveLength - 0.2) / 2);
+	for (long i = 0; i < nBins; i++) {
+		ProposedBin *bin = &bins[i];
+		bin->start = MAX(bin->start, bin->center - maxHalfWidth);
+		bin->end = MIN(bin->end, bin->center + maxHalfWidth);
+	}
+	for (long i = 1; i < nBins; i++) {
+		ProposedBin *previous = &bins[i-1], *bin = &bins[i];
+		if(bin->start - previous->end < binMargin) {
+			float mid = (previous->center + bin->center) / 2;
+			previous->end = MIN(previous->end, mid - binMargin/2);
+			bin->start = MAX(bin->start, mid + binMargin/2);
+			previous->issues |= ProposedBinIssueCrowded;
+			bin->issues |= ProposedBinIssueCrowded;
+		}
+	}
+
+	return binData;
+}
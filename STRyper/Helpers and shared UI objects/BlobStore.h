@@ -0,0 +1,102 @@
+//
+//  BlobStore.h
+//  STRyper
+//
+//  Created by Jean Peccoud on 18/10/2026.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+@import Foundation;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// A content-addressed store of large binary data (blobs) in files placed next to the database.
+///
+/// Binary attributes of managed objects can store a short reference to a blob (see ``referenceForData:``) instead of the data itself,
+/// so that rows of the database remain small.
+/// A blob is identified by the SHA-256 digest of its content, so that identical data are stored once, and is never modified once written.
+///
+/// Blobs are memory-mapped when read (see ``dataForReference:``) and the returned `NSData` objects are shared by all contexts and threads,
+/// as long as they are retained. Pages of a blob are therefore only loaded when accessed, and are not copied to the heap.
+///
+/// As managed objects do not delete blobs when they are deleted, blobs that are no longer referenced are removed by ``removeBlobsNotReferencedBy:olderThan:``,
+/// which should be called when the store ``needsCollection``.
+/// This class is thread safe.
+@interface BlobStore : NSObject
+
+/// The store associated with the database of the application, in a folder next to the database.
+///
+/// The folder name starts with the name of the database file, so that it is moved along the database files if the database needs to be backed up.
+@property (class, readonly, nullable) BlobStore *sharedStore;
+
+/// Returns a store of blobs in a given folder, which is created if needed.
+- (nullable instancetype)initWithFolderURL:(NSURL *)folderURL;
+
+/// The folder containing the blobs.
+@property (nonatomic, readonly) NSURL *folderURL;
+
+/// The minimum length in bytes of data that should be stored as a blob.
+///
+/// Smaller data occupies less space in the database than in a file.
+@property (class, readonly) NSUInteger minimumBlobLength;
+
+/// Returns whether data is a reference to a blob returned by ``referenceForData:``.
++ (BOOL)isBlobReference:(nullable NSData *)data;
+
+/// Writes data to a blob, if no blob with the same content exists, and returns a reference to this blob.
+///
+/// The reference is a short `NSData` object that can be stored in place of the data. Its content only depends on the content of the data.
+///
+/// Writing a new blob calls ``setNeedsCollection``, as the blob remains unreferenced if the reference is never saved in the database.
+/// - Parameter data: The data to store.
+/// - Returns: The reference to the blob, or `nil` if the blob could not be written.
+- (nullable NSData *)referenceForData:(NSData *)data;
+
+/// Returns the data of the blob that a reference points to.
+///
+/// The data is memory-mapped and read only. The same object is returned as long as it is retained somewhere.
+/// - Parameter reference: The reference to the blob.
+/// - Returns: The data, or `nil` if `reference` is not a reference to a blob or if the blob cannot be read.
+- (nullable NSData *)dataForReference:(NSData *)reference;
+
+/// Whether blobs may no longer be referenced, which is the case if ``setNeedsCollection`` was called since the last ``removeBlobsNotReferencedBy:olderThan:``.
+///
+/// This state is recorded in the folder of the store, hence persists across launches.
+@property (nonatomic, readonly) BOOL needsCollection;
+
+/// Records that blobs may no longer be referenced, for instance because objects that referenced them were deleted,
+/// or because new blobs were written for objects that may not be saved.
+- (void)setNeedsCollection;
+
+/// Deletes the blobs that are not pointed to by given references, and that were last written before a date.
+///
+/// The date avoids deleting blobs that were written after references were collected (for instance, by an import) but not saved in the database yet.
+/// - Parameters:
+///   - references: The references to blobs that must be kept.
+///   - date: The date before which a blob must have been written to be deleted.
+/// - Returns: The number of blobs deleted.
+- (NSUInteger)removeBlobsNotReferencedBy:(NSSet<NSData *> *)references olderThan:(NSDate *)date;
+
+/// Returns the references whose blob is missing or whose content does not correspond to its digest.
+///
+/// This method reads all blobs, hence can take time.
+/// - Parameters:
+///   - references: The references to check.
+///   - progress: A progress object whose completed unit count is incremented for each reference checked, and which can be used to cancel the check.
+- (NSArray<NSData *> *)invalidReferencesAmong:(NSSet<NSData *> *)references progress:(nullable NSProgress *)progress;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,231 @@
+//
+//  BlobStore.m
+//  STRyper
+//
+//  Created by Jean Peccoud on 18/10/2026.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#import "BlobStore.h"
+#import "AppDelegate.h"
+#import <CommonCrypto/CommonDigest.h>
+
+/// The first 4 bytes of a reference to a blob ("STRb" in ASCII).
+static const uint32_t BlobReferenceMagic = 0x62525453;
+
+static const uint32_t BlobReferenceVersion = 1;
+
+/// The content of a reference to a blob.
+typedef struct BlobReference {
+	uint32_t magic;
+	uint32_t version;
+	uint8_t digest[CC_SHA256_DIGEST_LENGTH];
+} BlobReference;
+
+/// The name of the file whose presence in the folder of a store indicates that blobs may no longer be referenced.
+static NSString *const collectionMarkerName = @"needs-collection";
+
+
+/// Returns the hexadecimal representation of a digest, which is used as a file name.
+static NSString *stringForDigest(const uint8_t *digest) {
+	char string[CC_SHA256_DIGEST_LENGTH * 2 + 1];
+	for (int i = 0; i < CC_SHA256_DIGEST_LENGTH; i++) {
+		snprintf(string + i*2, 3, "%02x", digest[i]);
+	}
+	return [NSString stringWithUTF8String:string];
+}
+
+
+@implementation BlobStore {
+	/// The blobs currently in memory, keyed by the string of their digest. Values are weak references.
+	NSMapTable<NSString *, NSData *> *openBlobs;
+	
+	/// Whether we have recorded that blobs may no longer be referenced, to avoid checking the file system each time.
+	BOOL needsCollection;
+}
+
+
++ (nullable BlobStore *)sharedStore {
+	static BlobStore *sharedStore = nil;
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		NSURL *databaseURL = AppDelegate.sharedInstance.persistentContainer.persistentStoreDescriptions.firstObject.URL;
+		if(databaseURL.isFileURL) {
+			NSString *folderName = [databaseURL.lastPathComponent stringByAppendingString:@"-blobs"];
+			NSURL *folderURL = [databaseURL.URLByDeletingLastPathComponent URLByAppendingPathComponent:folderName isDirectory:YES];
+			sharedStore = [[BlobStore alloc] initWithFolderURL:folderURL];
+		}
+	});
+	return sharedStore;
+}
+
+
++ (NSUInteger)minimumBlobLength {
+	return 4096;
+}
+
+
+- (nullable instancetype)initWithFolderURL:(NSURL *)folderURL {
+	NSError *error;
+	if(![NSFileManager.defaultManager createDirectoryAtURL:folderURL withIntermediateDirectories:YES attributes:nil error:&error]) {
+		NSLog(@"Failed to create the blob folder: %@", error);
+		return nil;
+	}
+	self = [super init];
+	if(self) {
+		_folderURL = folderURL;
+		openBlobs = NSMapTable.strongToWeakObjectsMapTable;
+	}
+	return self;
+}
+
+
++ (BOOL)isBlobReference:(nullable NSData *)data {
+	if(data.length != sizeof(BlobReference)) {
+		return NO;
+	}
+	const BlobReference *reference = data.bytes;
+	return reference->magic == BlobReferenceMagic && reference->version == BlobReferenceVersion;
+}
+
+
+/// Returns the URL of the file of a blob. Files are distributed in subfolders named after the first two characters of their name, to keep folders small.
+- (NSURL *)URLForDigestString:(NSString *)digestString {
+	NSURL *subfolderURL = [self.folderURL URLByAppendingPathComponent:[digestString substringToIndex:2] isDirectory:YES];
+	return [subfolderURL URLByAppendingPathComponent:digestString isDirectory:NO];
+}
+
+
+- (nullable NSData *)referenceForData:(NSData *)data {
+	BlobReference reference = {.magic = BlobReferenceMagic, .version = BlobReferenceVersion};
+	CC_SHA256(data.bytes, (CC_LONG)data.length, reference.digest);
+	NSURL *URL = [self URLForDigestString:stringForDigest(reference.digest)];
+	NSFileManager *fileManager = NSFileManager.defaultManager;
+	if([fileManager fileExistsAtPath:URL.path]) {
+		/// The blob already exists. We update its modification date so that it is not deleted by a collection that started before it is referenced again.
+		[fileManager setAttributes:@{NSFileModificationDate: NSDate.date} ofItemAtPath:URL.path error:nil];
+	} else {
+		NSError *error;
+		[fileManager createDirectoryAtURL:URL.URLByDeletingLastPathComponent withIntermediateDirectories:YES attributes:nil error:nil];
+		if(![data writeToURL:URL options:NSDataWritingAtomic error:&error]) {
+			NSLog(@"Failed to write blob: %@", error);
+			return nil;
+		}
+		/// The new blob is only referenced once the object using the reference is saved, which may never happen
+		/// (the import is cancelled or fails, the context is discarded, or the application quits before saving).
+		[self setNeedsCollection];
+	}
+	return [NSData dataWithBytes:&reference length:sizeof(reference)];
+}
+
+
+- (nullable NSData *)dataForReference:(NSData *)reference {
+	if(![BlobStore isBlobReference:reference]) {
+		return nil;
+	}
+	NSString *digestString = stringForDigest(((const BlobReference *)reference.bytes)->digest);
+	@synchronized (self) {
+		NSData *data = [openBlobs objectForKey:digestString];
+		if(!data) {
+			NSError *error;
+			data = [NSData dataWithContentsOfURL:[self URLForDigestString:digestString] options:NSDataReadingMappedAlways error:&error];
+			if(data) {
+				[openBlobs setObject:data forKey:digestString];
+			} else {
+				NSLog(@"Failed to read blob %@: %@", digestString, error);
+			}
+		}
+		return data;
+	}
+}
+
+
+- (BOOL)needsCollection {
+	return [NSFileManager.defaultManager fileExistsAtPath:[self.folderURL URLByAppendingPathComponent:collectionMarkerName].path];
+}
+
+
+- (void)setNeedsCollection {
+	@synchronized (self) {
+		if(!needsCollection) {
+			needsCollection = YES;
+			[NSData.data writeToURL:[self.folderURL URLByAppendingPathComponent:collectionMarkerName] atomically:NO];
+		}
+	}
+}
+
+
+- (NSUInteger)removeBlobsNotReferencedBy:(NSSet<NSData *> *)references olderThan:(NSDate *)date {
+	NSFileManager *fileManager = NSFileManager.defaultManager;
+	/// The marker is removed first, so that blobs released during the collection will be collected next time.
+	@synchronized (self) {
+		needsCollection = NO;
+		[fileManager removeItemAtURL:[self.folderURL URLByAppendingPathComponent:collectionMarkerName] error:nil];
+	}
+
+	NSMutableSet<NSString *> *referencedDigests = [NSMutableSet setWithCapacity:references.count];
+	for(NSData *reference in references) {
+		if([BlobStore isBlobReference:reference]) {
+			[referencedDigests addObject:stringForDigest(((const BlobReference *)reference.bytes)->digest)];
+		}
+	}
+
+	NSArray *keys = @[NSURLIsRegularFileKey, NSURLContentModificationDateKey];
+	NSDirectoryEnumerator<NSURL *> *enumerator = [fileManager enumeratorAtURL:self.folderURL includingPropertiesForKeys:keys
+																	   options:NSDirectoryEnumerationSkipsHiddenFiles errorHandler:nil];
+	NSUInteger nRemoved = 0;
+	for(NSURL *URL in enumerator) {
+		NSNumber *isFile;
+		NSDate *modificationDate;
+		[URL getResourceValue:&isFile forKey:NSURLIsRegularFileKey error:nil];
+		[URL getResourceValue:&modificationDate forKey:NSURLContentModificationDateKey error:nil];
+		NSString *name = URL.lastPathComponent;
+		if(!isFile.boolValue || name.length != CC_SHA256_DIGEST_LENGTH * 2 || [referencedDigests containsObject:name]
+		   || !modificationDate || [modificationDate compare:date] != NSOrderedAscending) {
+			continue;
+		}
+		/// A blob that is memory-mapped remains readable after its file is deleted.
+		if([fileManager removeItemAtURL:URL error:nil]) {
+			nRemoved++;
+		}
+	}
+	return nRemoved;
+}
+
+
+- (NSArray<NSData *> *)invalidReferencesAmong:(NSSet<NSData *> *)references progress:(nullable NSProgress *)progress {
+	NSMutableArray *invalidReferences = NSMutableArray.new;
+	for(NSData *reference in references) {
+		if(progress.isCancelled) {
+			break;
+		}
+		@autoreleasepool {
+			NSData *data = [self dataForReference:reference];
+			BOOL valid = NO;
+			if(data) {
+				uint8_t digest[CC_SHA256_DIGEST_LENGTH];
+				CC_SHA256(data.bytes, (CC_LONG)data.length, digest);
+				valid = memcmp(digest, ((const BlobReference *)reference.bytes)->digest, CC_SHA256_DIGEST_LENGTH) == 0;
+			}
+			if(!valid) {
+				[invalidReferences addObject:reference];
+			}
+		}
+		progress.completedUnitCount++;
+	}
+	return invalidReferences;
+}
+
+@end
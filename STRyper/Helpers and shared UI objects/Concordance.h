@@ -0,0 +1,98 @@
+//
+//  Concordance.h
+//  STRyper
+//
+//  Created by Jean Peccoud on 18/10/2026.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+@import Foundation;
+
+@class Chromatogram;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// A genotype to compare with ``computeConcordance``, described by indices.
+typedef struct ConcordanceGenotype {
+	/// The index of the group of the sample. Genotypes are only compared within groups (e.g., replicates of an individual).
+	int32_t group;
+
+	/// The index of the sample.
+	int32_t sample;
+
+	/// The index of the run of the sample.
+	int32_t run;
+
+	/// The index of the marker.
+	int32_t marker;
+
+	/// A hash of the alleles of the genotype, which does not depend on their order.
+	uint64_t allelesHash;
+} ConcordanceGenotype;
+
+/// The number of genotype comparisons and of mismatches among them.
+///
+/// Counts are 64-bit integers, as a marker or a run may total billions of comparisons.
+typedef struct ConcordanceCount {
+	int64_t nCompared;
+	int64_t nMismatches;
+} ConcordanceCount;
+
+/// The comparisons between two samples of a group, where `sample1` < `sample2`.
+typedef struct SamplePairConcordance {
+	int32_t sample1;
+	int32_t sample2;
+	ConcordanceCount count;
+} SamplePairConcordance;
+
+
+/// Compares the genotypes of samples of the same group at each marker, and counts mismatches per marker, per run and per pair of samples.
+///
+/// Genotypes are joined on their group and marker through a hash table, so that only genotypes to compare are visited.
+/// Each pair of genotypes of different samples in a join makes one comparison, which is a mismatch if their `allelesHash` members differ.
+/// A comparison is counted for the runs of both samples (once if they are from the same run).
+///
+/// The time taken is proportional to the number of genotypes plus the number of comparisons.
+/// As the number of comparisons grows with the square of the number of genotypes in a join, callers should limit the size of groups (see ``ConcordanceMaxGroupSize``).
+/// - Parameters:
+///   - genotypes: The genotypes to compare.
+///   - nGenotypes: The number of genotypes.
+///   - markerCounts: The counts of each marker, which are incremented. The array must have room for the number of markers and is normally filled with zeros.
+///   - runCounts: The counts of each run, which are incremented. The array must have room for the number of runs and is normally filled with zeros.
+///   - progress: A progress whose `completedUnitCount` is increased by the number of genotypes whose comparisons are done.
+///   If it is cancelled, the function stops and returns `nil`.
+/// - Returns: An array of ``SamplePairConcordance`` structs, for pairs of samples that were compared, sorted by `sample1` then `sample2`.
+NSData *_Nullable computeConcordance(const ConcordanceGenotype *genotypes, long nGenotypes, ConcordanceCount *markerCounts, ConcordanceCount *runCounts, NSProgress *_Nullable progress);
+
+
+/// The maximum number of samples in a group for ``concordanceReportForSamples``.
+///
+/// Larger groups, which denote a key that does not identify replicates of an individual, are not compared and are listed in the report.
+extern const int ConcordanceMaxGroupSize;
+
+/// Returns a tab-delimited report of the concordance of genotypes between samples that share a key, computed with ``computeConcordance``.
+///
+/// Genotypes that have no allele with a peak are ignored, as are genotypes of samples that are not sized.
+/// Alleles are compared by name, so genotypes should be binned beforehand.
+/// The report lists the mismatch rates per marker, per run (``Chromatogram/runName``) and per pair of samples.
+///
+/// This function can take a while for many samples. It can be called on any thread, but the samples must belong to the context of this thread.
+/// - Parameters:
+///   - samples: The samples to compare.
+///   - keyForSample: A block returning the key of a sample. Samples with the same key are compared. Samples for which the block returns `nil` are ignored.
+///   - progress: A progress that the function sets and updates. If it is cancelled, the function returns `nil`.
+NSString *_Nullable concordanceReportForSamples(NSArray<Chromatogram *> *samples, NSString *_Nullable (^keyForSample)(Chromatogram *sample), NSProgress *_Nullable progress);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,351 @@
+//
+//  Concordance.m
+//  STRyper
+//
+//  Created by Jean Peccoud on 18/10/2026.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#import "Concordance.h"
+#import "Chromatogram.h"
+#import "Genotype.h"
+#import "Allele.h"
+#import "Mmarker.h"
+#import "Panel.h"
+
+
+/// Mixes the bits of a 64-bit key, to index hash tables.
+static inline uint64_t mixKey(uint64_t key) {
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return key;
+}
+
+
+/// An open-addressing hash table that maps 64-bit keys to indices.
+typedef struct IndexTable {
+	uint64_t *keys;
+	int64_t *values;		/// -1 for an empty slot
+	uint64_t mask;			/// the capacity minus 1, the capacity being a power of 2
+	long count;
+} IndexTable;
+
+
+static void initIndexTable(IndexTable *table, long minCapacity) {
+	uint64_t capacity = 16;
+	while(capacity < minCapacity * 2) {
+		capacity *= 2;
+	}
+	table->keys = malloc(capacity * sizeof(uint64_t));
+	table->values = malloc(capacity * sizeof(int64_t));
+	memset(table->values, -1, capacity * sizeof(int64_t));
+	table->mask = capacity - 1;
+	table->count = 0;
+}
+
+
+static void freeIndexTable(IndexTable *table) {
+	free(table->keys);
+	free(table->values);
+}
+
+
+/// Returns the slot of a key in the table, which is empty if the key is absent.
+static inline uint64_t slotForKey(const IndexTable *table, uint64_t key) {
+	uint64_t slot = mixKey(key) & table->mask;
+	while(table->values[slot] >= 0 && table->keys[slot] != key) {
+		slot = (slot + 1) & table->mask;
+	}
+	return slot;
+}
+
+
+static void setValueForSlot(IndexTable *table, uint64_t slot, uint64_t key, int64_t value) {
+	if(table->values[slot] < 0) {
+		table->count++;
+	}
+	table->keys[slot] = key;
+	table->values[slot] = value;
+	if(table->count * 2 > table->mask) {
+		/// We keep the load factor under 1/2, by doubling the capacity.
+		IndexTable previous = *table;
+		initIndexTable(table, previous.mask + 1);
+		for (uint64_t i = 0; i <= previous.mask; i++) {
+			if(previous.values[i] >= 0) {
+				uint64_t newSlot = slotForKey(table, previous.keys[i]);
+				table->keys[newSlot] = previous.keys[i];
+				table->values[newSlot] = previous.values[i];
+				table->count++;
+			}
+		}
+		freeIndexTable(&previous);
+	}
+}
+
+
+static int comparePairs(const void *a, const void *b) {
+	const SamplePairConcordance *pair1 = a, *pair2 = b;
+	if(pair1->sample1 != pair2->sample1) {
+		return pair1->sample1 < pair2->sample1? -1 : 1;
+	}
+	return (pair1->sample2 > pair2->sample2) - (pair1->sample2 < pair2->sample2);
+}
+
+
+NSData *computeConcordance(const ConcordanceGenotype *genotypes, long nGenotypes, ConcordanceCount *markerCounts, ConcordanceCount *runCounts, NSProgress *progress) {
+	NSMutableData *pairData = NSMutableData.new;
+	if(nGenotypes < 2) {
+		return pairData;
+	}
+
+	/// We join genotypes on their group and marker. The table gives the last genotype of each join, and `previous` chains genotypes of the same join.
+	IndexTable joins;
+	initIndexTable(&joins, nGenotypes);
+	int64_t *previous = malloc(nGenotypes * sizeof(int64_t));
+	for (long i = 0; i < nGenotypes; i++) {
+		uint64_t key = (uint64_t)(uint32_t)genotypes[i].group << 32 | (uint32_t)genotypes[i].marker;
+		uint64_t slot = slotForKey(&joins, key);
+		previous[i] = joins.values[slot];
+		setValueForSlot(&joins, slot, key, i);
+	}
+
+	IndexTable pairs;
+	initIndexTable(&pairs, 1024);
+	long *joined = malloc(nGenotypes * sizeof(long));
+	BOOL cancelled = NO;
+	for (uint64_t slot = 0; slot <= joins.mask; slot++) {
+		if(joins.values[slot] < 0) {
+			continue;
+		}
+		if(progress.isCancelled) {
+			cancelled = YES;
+			break;
+		}
+		long nJoined = 0;
+		for (int64_t i = joins.values[slot]; i >= 0; i = previous[i]) {
+			joined[nJoined++] = i;
+		}
+		for (long i = 0; i < nJoined; i++) {
+			const ConcordanceGenotype *genotype1 = &genotypes[joined[i]];
+			for (long j = i+1; j < nJoined; j++) {
+				const ConcordanceGenotype *genotype2 = &genotypes[joined[j]];
+				if(genotype1->sample == genotype2->sample) {
+					continue;
+				}
+				bool mismatch = genotype1->allelesHash != genotype2->allelesHash;
+				markerCounts[genotype1->marker].nCompared++;
+				markerCounts[genotype1->marker].nMismatches += mismatch;
+				runCounts[genotype1->run].nCompared++;
+				runCounts[genotype1->run].nMismatches += mismatch;
+				if(genotype2->run != genotype1->run) {
+					runCounts[genotype2->run].nCompared++;
+					runCounts[genotype2->run].nMismatches += mismatch;
+				}
+
+				int32_t sample1 = MIN(genotype1->sample, genotype2->sample), sample2 = MAX(genotype1->sample, genotype2->sample);
+				uint64_t key = (uint64_t)(uint32_t)sample1 << 32 | (uint32_t)sample2;
+				uint64_t pairSlot = slotForKey(&pairs, key);
+				int64_t pairIndex = pairs.values[pairSlot];
+				if(pairIndex < 0) {
+					pairIndex = pairData.length / sizeof(SamplePairConcordance);
+					SamplePairConcordance pair = {.sample1 = sample1, .sample2 = sample2};
+					[pairData appendBytes:&pair length:sizeof(pair)];
+					setValueForSlot(&pairs, pairSlot, key, pairIndex);
+				}
+				SamplePairConcordance *pair = (SamplePairConcordance *)pairData.mutableBytes + pairIndex;
+				pair->count.nCompared++;
+				pair->count.nMismatches += mismatch;
+			}
+		}
+		progress.completedUnitCount += nJoined;
+	}
+
+	free(joined);
+	freeIndexTable(&pairs);
+	free(previous);
+	freeIndexTable(&joins);
+	if(cancelled) {
+		return nil;
+	}
+
+	qsort(pairData.mutableBytes, pairData.length / sizeof(SamplePairConcordance), sizeof(SamplePairConcordance), comparePairs);
+	return pairData;
+}
+
+
+/// Returns a hash of the alleles of a genotype that does not depend on their order, or 0 if the genotype has no allele with a peak.
+static uint64_t allelesHashOfGenotype(Genotype *genotype) {
+	NSMutableArray<NSString *> *alleleStrings = NSMutableArray.new;
+	for(Allele *allele in genotype.assignedAlleles) {
+		if(allele.scan > 0) {
+			[alleleStrings addObject:allele.string];
+		}
+	}
+	if(alleleStrings.count == 0) {
+		return 0;
+	}
+	[alleleStrings sortUsingSelector:@selector(compare:)];
+
+	/// We use the 64-bit FNV-1a hash of the allele strings, separated by a character that cannot be typed in allele names.
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for(NSString *string in alleleStrings) {
+		const char *bytes = string.UTF8String;
+		for (const char *c = bytes; *c; c++) {
+			hash = (hash ^ (uint8_t)*c) * 0x100000001b3ULL;
+		}
+		hash = (hash ^ 0x1F) * 0x100000001b3ULL;
+	}
+	return hash == 0? 1 : hash;
+}
+
+
+/// Returns the index of a string in an array, adding it at the end if it is absent.
+static int32_t indexOfString(NSString *string, NSMutableDictionary<NSString *, NSNumber *> *indices, NSMutableArray<NSString *> *strings) {
+	NSNumber *index = indices[string];
+	if(!index) {
+		index = @(strings.count);
+		indices[string] = index;
+		[strings addObject:string];
+	}
+	return index.intValue;
+}
+
+
+static NSString *rowForCount(NSString *title, ConcordanceCount count) {
+	return [NSString stringWithFormat:@"%@\t%lld\t%lld\t%.4f", title, count.nCompared, count.nMismatches, (double)count.nMismatches / count.nCompared];
+}
+
+
+const int ConcordanceMaxGroupSize = 100;
+
+
+NSString *concordanceReportForSamples(NSArray<Chromatogram *> *samples, NSString *(^keyForSample)(Chromatogram *), NSProgress *progress) {
+	/// Progress units are samples read, then genotypes compared.
+	progress.totalUnitCount = samples.count * 2;
+	NSMutableDictionary<NSString *, NSNumber *> *groupIndices = NSMutableDictionary.new, *runIndices = NSMutableDictionary.new;
+	NSMutableArray<NSString *> *groups = NSMutableArray.new, *runs = NSMutableArray.new;
+	NSMapTable<Mmarker *, NSNumber *> *markerIndices = NSMapTable.strongToStrongObjectsMapTable;
+	NSMutableArray<Mmarker *> *markers = NSMutableArray.new;
+	NSMutableArray<Chromatogram *> *comparedSamples = NSMutableArray.new;
+	NSMutableData *genotypeData = NSMutableData.new;
+	NSMutableData *groupSizeData = NSMutableData.new;
+
+	for(Chromatogram *sample in samples) {
+		if(progress.isCancelled) {
+			return nil;
+		}
+		progress.completedUnitCount++;
+		if(sample.sizingQuality.floatValue <= 0) {
+			continue;
+		}
+		NSString *key = keyForSample(sample);
+		if(key.length == 0) {
+			continue;
+		}
+		ConcordanceGenotype record;
+		record.group = indexOfString(key, groupIndices, groups);
+		if(groupSizeData.length < groups.count * sizeof(int)) {
+			groupSizeData.length = groups.count * sizeof(int);
+		}
+		((int *)groupSizeData.mutableBytes)[record.group]++;
+		record.run = indexOfString(sample.runName ?: @"", runIndices, runs);
+		record.sample = (int32_t)comparedSamples.count;
+		[comparedSamples addObject:sample];
+
+		for(Genotype *genotype in sample.genotypes) {
+			GenotypeStatus status = genotype.status;
+			if(status == genotypeStatusNotCalled || status == genotypeStatusNoSizing) {
+				continue;
+			}
+			record.allelesHash = allelesHashOfGenotype(genotype);
+			if(record.allelesHash == 0) {
+				continue;
+			}
+			Mmarker *marker = genotype.marker;
+			NSNumber *markerIndex = [markerIndices objectForKey:marker];
+			if(!markerIndex) {
+				markerIndex = @(markers.count);
+				[markerIndices setObject:markerIndex forKey:marker];
+				[markers addObject:marker];
+			}
+			record.marker = markerIndex.intValue;
+			[genotypeData appendBytes:&record length:sizeof(record)];
+		}
+	}
+
+	/// The number of comparisons in a group grows with the square of its size, so we exclude groups that are too large.
+	const int *groupSizes = groupSizeData.bytes;
+	ConcordanceGenotype *records = genotypeData.mutableBytes;
+	long nGenotypes = 0;
+	for (long i = 0; i < genotypeData.length / sizeof(ConcordanceGenotype); i++) {
+		if(groupSizes[records[i].group] <= ConcordanceMaxGroupSize) {
+			records[nGenotypes++] = records[i];
+		}
+	}
+	progress.totalUnitCount = samples.count + nGenotypes;
+
+	ConcordanceCount *markerCounts = calloc(MAX(1, markers.count), sizeof(ConcordanceCount));
+	ConcordanceCount *runCounts = calloc(MAX(1, runs.count), sizeof(ConcordanceCount));
+	NSData *pairData = computeConcordance(records, nGenotypes, markerCounts, runCounts, progress);
+	if(!pairData) {
+		free(markerCounts);
+		free(runCounts);
+		return nil;
+	}
+
+	NSMutableArray<NSString *> *rows = NSMutableArray.new;
+	[rows addObject:@"Panel\tMarker\tComparisons\tMismatches\tMismatch rate"];
+	for (NSInteger i = 0; i < markers.count; i++) {
+		if(markerCounts[i].nCompared > 0) {
+			Mmarker *marker = markers[i];
+			NSString *title = [NSString stringWithFormat:@"%@\t%@", marker.panel.name, marker.name];
+			[rows addObject:rowForCount(title, markerCounts[i])];
+		}
+	}
+
+	[rows addObject:@"\nRun\tComparisons\tMismatches\tMismatch rate"];
+	for (NSInteger i = 0; i < runs.count; i++) {
+		if(runCounts[i].nCompared > 0) {
+			[rows addObject:rowForCount(runs[i], runCounts[i])];
+		}
+	}
+
+	[rows addObject:@"\nGroup\tSample 1\tRun 1\tSample 2\tRun 2\tComparisons\tMismatches\tMismatch rate"];
+	const SamplePairConcordance *pairs = pairData.bytes;
+	for (long i = 0; i < pairData.length / sizeof(SamplePairConcordance); i++) {
+		Chromatogram *sample1 = comparedSamples[pairs[i].sample1], *sample2 = comparedSamples[pairs[i].sample2];
+		NSString *title = [NSString stringWithFormat:@"%@\t%@\t%@\t%@\t%@", keyForSample(sample1), sample1.sampleName, sample1.runName ?: @"",
+						   sample2.sampleName, sample2.runName ?: @""];
+		[rows addObject:rowForCount(title, pairs[i].count)];
+	}
+
+	NSMutableArray<NSString *> *excludedRows = NSMutableArray.new;
+	for (NSInteger i = 0; i < groups.count; i++) {
+		if(groupSizes[i] > ConcordanceMaxGroupSize) {
+			[excludedRows addObject:[NSString stringWithFormat:@"%@\t%d", groups[i], groupSizes[i]]];
+		}
+	}
+	if(excludedRows.count > 0) {
+		[rows addObject:[NSString stringWithFormat:@"\nGroups not compared (more than %d samples)\tSamples", ConcordanceMaxGroupSize]];
+		[rows addObjectsFromArray:excludedRows];
+	}
+
+	free(markerCounts);
+	free(runCounts);
+	return [rows componentsJoinedByString:@"\n"];
+}
@@ -0,0 +1,94 @@
+//
+//  DataCache.h
+//  STRyper
+//
+//  Created by Jean Peccoud on 18/10/2026.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+
+@import Foundation;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// The category of data stored in a ``DataCache``, used to report the memory taken by each kind of data.
+typedef NSString *const DataCacheCategory;
+
+/// Decoded fluorescence data (see ``FluoTrace/rawData``).
+extern DataCacheCategory DataCacheCategoryFluorescence,
+
+/// Fluorescence data with baseline removed, used to draw traces.
+DataCacheCategoryAdjustedFluorescence,
+
+/// Arrays of sizes (see ``Chromatogram/sizes``).
+DataCacheCategorySizes;
+
+
+/// A cache that retains data computed by objects (typically from their core data attributes) within a global byte limit.
+///
+/// An object that computes data adds it to the cache and keeps a weak reference to it, which it uses as long as the data is not deallocated.
+/// When the data in the cache exceeds the ``byteLimit``, the least recently used data is removed from the cache,
+/// and deallocated if no other object holds a strong reference to it. The object must then compute the data again when it needs it.
+/// Objects should call ``useData:`` when they access their data, so that data used frequently remains in the cache.
+///
+/// The cache also frees memory when the system signals memory pressure.
+///
+/// The methods of this class are thread-safe.
+@interface DataCache : NSObject
+
+/// The cache used by objects of the application.
+///
+/// Its ``byteLimit`` can be set with the `DataCacheMegabytes` user default.
+@property (class, readonly) DataCache *sharedCache;
+
+/// The maximum number of bytes that the data stored in the cache can take.
+///
+/// Setting this property removes data from the cache if needed.
+///
+/// The default value is 256 MB.
+@property (nonatomic) NSUInteger byteLimit;
+
+/// The number of bytes taken by the data stored in the cache.
+@property (nonatomic, readonly) NSUInteger totalBytes;
+
+/// Adds data to the cache, which becomes the most recently used.
+///
+/// This method removes the least recently used data if the ``byteLimit`` is exceeded. It does nothing if `data` is already in the cache.
+/// - Parameters:
+///   - data: The data to add. Data objects are identified by their address, not by their content.
+///   - category: The category of the data.
+- (void)addData:(NSData *)data category:(DataCacheCategory)category;
+
+/// Makes data the most recently used, if it is in the cache.
+- (void)useData:(nullable NSData *)data;
+
+/// Removes data from the cache, for instance when the object that computed it no longer needs it.
+- (void)removeData:(nullable NSData *)data;
+
+/// Removes all data from the cache.
+- (void)removeAllData;
+
+/// The number of bytes taken by the data of each category.
+@property (nonatomic, readonly) NSDictionary<DataCacheCategory, NSNumber *> *bytesPerCategory;
+
+/// A description of the use of the cache for each category: the memory taken, the number of data objects stored,
+/// and the number of objects added and removed because the cache was full, since launch.
+///
+/// This can help diagnosing the growth of memory use.
+@property (nonatomic, readonly) NSString *statistics;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,264 @@
+//
+//  DataCache.m
+//  STRyper
+//
+//  Created by Jean Peccoud on 18/10/2026.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+
+#import "DataCache.h"
+
+DataCacheCategory DataCacheCategoryFluorescence = @"Fluorescence",
+DataCacheCategoryAdjustedFluorescence = @"Adjusted fluorescence",
+DataCacheCategorySizes = @"Sizes";
+
+
+/// An item of the cache.
+///
+/// Entries form a doubly-linked list in the order of use, so that an entry can be moved or removed in constant time.
+/// Entries are retained by the map table of the cache, hence the links do not retain them.
+@interface DataCacheEntry : NSObject {
+	@public
+	NSData *data;
+	DataCacheCategory category;
+	__unsafe_unretained DataCacheEntry *previous;	/// The entry that was used before, or `nil`.
+	__unsafe_unretained DataCacheEntry *next;		/// The entry that was used after, or `nil`.
+}
+@end
+
+@implementation DataCacheEntry
+@end
+
+
+/// The use of the cache for a category.
+typedef struct CategoryStatistics {
+	NSUInteger bytes;
+	NSUInteger count;
+	NSUInteger nAdded;
+	NSUInteger nEvicted;
+} CategoryStatistics;
+
+
+@implementation DataCache {
+	/// The entries of the cache, keyed by their data (compared by address).
+	NSMapTable<NSData *, DataCacheEntry *> *entries;
+
+	/// The least recently used entry and the most recently used entry, which are the ends of the list of entries.
+	__unsafe_unretained DataCacheEntry *leastRecentEntry, *mostRecentEntry;
+
+	/// The statistics of each category, as `NSValue` objects wrapping `CategoryStatistics` structs.
+	NSMutableDictionary<DataCacheCategory, NSValue *> *categoryStatistics;
+
+	/// The source of memory pressure events.
+	dispatch_source_t memoryPressureSource;
+}
+
+
++ (DataCache *)sharedCache {
+	static DataCache *sharedCache = nil;
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		sharedCache = self.new;
+		NSInteger megabytes = [NSUserDefaults.standardUserDefaults integerForKey:@"DataCacheMegabytes"];
+		if(megabytes > 0) {
+			sharedCache.byteLimit = megabytes * 1024 * 1024;
+		}
+	});
+	return sharedCache;
+}
+
+
+- (instancetype)init {
+	self = [super init];
+	if (self) {
+		entries = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsObjectPointerPersonality | NSPointerFunctionsStrongMemory
+										valueOptions:NSPointerFunctionsStrongMemory];
+		categoryStatistics = NSMutableDictionary.new;
+		_byteLimit = 256 * 1024 * 1024;
+		
+		/// When memory is low, we keep only a quarter of the limit, or nothing if the pressure is critical.
+		memoryPressureSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+													  DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL, dispatch_get_main_queue());
+		__weak typeof(self) weakSelf = self;
+		dispatch_source_set_event_handler(memoryPressureSource, ^{
+			DataCache *cache = weakSelf;
+			if(cache) {
+				BOOL critical = (dispatch_source_get_data(cache->memoryPressureSource) & DISPATCH_MEMORYPRESSURE_CRITICAL) != 0;
+				NSLog(@"Memory pressure. %@", cache.statistics);
+				@synchronized (cache) {
+					[cache removeDataBeyondLimit:critical? 0 : cache->_byteLimit / 4];
+				}
+			}
+		});
+		dispatch_resume(memoryPressureSource);
+	}
+	return self;
+}
+
+
+- (void)dealloc {
+	dispatch_source_cancel(memoryPressureSource);
+}
+
+
+/// Adds values to the statistics of a category.
+- (void)updateStatisticsForCategory:(DataCacheCategory)category bytes:(long)bytes count:(long)count added:(NSUInteger)nAdded evicted:(NSUInteger)nEvicted {
+	CategoryStatistics statistics = {0};
+	[categoryStatistics[category] getValue:&statistics size:sizeof(statistics)];
+	statistics.bytes += bytes;
+	statistics.count += count;
+	statistics.nAdded += nAdded;
+	statistics.nEvicted += nEvicted;
+	categoryStatistics[category] = [NSValue valueWithBytes:&statistics objCType:@encode(CategoryStatistics)];
+}
+
+
+/// Removes an entry from the list of entries.
+- (void)unlinkEntry:(DataCacheEntry *)entry {
+	if(entry->previous) {
+		entry->previous->next = entry->next;
+	} else {
+		leastRecentEntry = entry->next;
+	}
+	if(entry->next) {
+		entry->next->previous = entry->previous;
+	} else {
+		mostRecentEntry = entry->previous;
+	}
+	entry->previous = nil;
+	entry->next = nil;
+}
+
+
+/// Places an entry that is not in the list of entries at its end, as the most recently used.
+- (void)appendEntry:(DataCacheEntry *)entry {
+	entry->previous = mostRecentEntry;
+	entry->next = nil;
+	if(mostRecentEntry) {
+		mostRecentEntry->next = entry;
+	} else {
+		leastRecentEntry = entry;
+	}
+	mostRecentEntry = entry;
+}
+
+
+- (void)addData:(NSData *)data category:(DataCacheCategory)category {
+	@synchronized (self) {
+		if([entries objectForKey:data]) {
+			return;
+		}
+		DataCacheEntry *entry = DataCacheEntry.new;
+		entry->data = data;
+		entry->category = category;
+		[entries setObject:entry forKey:data];
+		[self appendEntry:entry];
+		_totalBytes += data.length;
+		[self updateStatisticsForCategory:category bytes:data.length count:1 added:1 evicted:0];
+		[self removeDataBeyondLimit:_byteLimit];
+	}
+}
+
+
+- (void)useData:(nullable NSData *)data {
+	if(!data) {
+		return;
+	}
+	@synchronized (self) {
+		DataCacheEntry *entry = [entries objectForKey:data];
+		if(entry && mostRecentEntry != entry) {
+			[self unlinkEntry:entry];
+			[self appendEntry:entry];
+		}
+	}
+}
+
+
+/// Removes an entry from the cache.
+- (void)removeEntry:(DataCacheEntry *)entry evicted:(BOOL)evicted {
+	_totalBytes -= entry->data.length;
+	[self updateStatisticsForCategory:entry->category bytes:-(long)entry->data.length count:-1 added:0 evicted:evicted];
+	[self unlinkEntry:entry];
+	/// This releases the entry, which must therefore be done last.
+	[entries removeObjectForKey:entry->data];
+}
+
+
+- (void)removeData:(nullable NSData *)data {
+	if(!data) {
+		return;
+	}
+	@synchronized (self) {
+		DataCacheEntry *entry = [entries objectForKey:data];
+		if(entry) {
+			[self removeEntry:entry evicted:NO];
+		}
+	}
+}
+
+
+- (void)setByteLimit:(NSUInteger)byteLimit {
+	@synchronized (self) {
+		_byteLimit = byteLimit;
+		[self removeDataBeyondLimit:byteLimit];
+	}
+}
+
+/// Removes the least recently used data until the ``totalBytes`` no longer exceeds a limit.
+///
+/// The most recently used data is never removed, unless the limit is 0.
+- (void)removeDataBeyondLimit:(NSUInteger)limit {
+	while(_totalBytes > limit && leastRecentEntry && (limit == 0 || leastRecentEntry != mostRecentEntry)) {
+		[self removeEntry:leastRecentEntry evicted:YES];
+	}
+}
+
+
+- (void)removeAllData {
+	@synchronized (self) {
+		[self removeDataBeyondLimit:0];
+	}
+}
+
+
+- (NSDictionary<DataCacheCategory,NSNumber *> *)bytesPerCategory {
+	NSMutableDictionary *bytesPerCategory = NSMutableDictionary.new;
+	@synchronized (self) {
+		for(DataCacheCategory category in categoryStatistics) {
+			CategoryStatistics statistics;
+			[categoryStatistics[category] getValue:&statistics size:sizeof(statistics)];
+			bytesPerCategory[category] = @(statistics.bytes);
+		}
+	}
+	return bytesPerCategory;
+}
+
+
+- (NSString *)statistics {
+	NSMutableString *description;
+	@synchronized (self) {
+		description = [NSMutableString stringWithFormat:@"Cache: %.1f MB of %.1f MB", _totalBytes / 1048576.0, _byteLimit / 1048576.0];
+		for(DataCacheCategory category in [categoryStatistics.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+			CategoryStatistics statistics;
+			[categoryStatistics[category] getValue:&statistics size:sizeof(statistics)];
+			[description appendFormat:@"\n%@: %.1f MB in %ld objects, %ld added, %ld evicted", category,
+			 statistics.bytes / 1048576.0, statistics.count, statistics.nAdded, statistics.nEvicted];
+		}
+	}
+	return description;
+}
+
+@end
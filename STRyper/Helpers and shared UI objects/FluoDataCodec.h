@@ -0,0 +1,70 @@
+//
+//  FluoDataCodec.h
+//  STRyper
+//
+//  Created by Jean Peccoud on 18/10/2026.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+@import Foundation;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Lossless compression of fluorescence data (arrays of 16-bit integers) stored in the ``FluoTrace/rawData`` attribute.
+///
+/// Encoded data starts with a header that identifies it, so that functions of this file also accept unencoded data, which they treat as is.
+/// Scans are grouped in blocks of ``FluoDataBlockLength`` scans. A block stores the level of its first scan,
+/// followed by the differences between successive scans, which are bit-packed by groups of 32 at the width required by the largest difference of the group.
+/// As fluorescence varies little between adjacent scans outside peaks, most differences take a few bits.
+///
+/// The header contains the offset of each block, so that a range of scans can be decoded without decoding the whole data.
+
+/// The number of scans in a block of encoded fluorescence data.
+#define FluoDataBlockLength 256
+
+/// Returns whether data is encoded by ``encodeFluoData``.
+BOOL isEncodedFluoData(NSData *_Nullable data);
+
+/// Returns an encoded version of fluorescence data, or the data itself if encoding would not make it smaller.
+/// - Parameter fluoData: The fluorescence data to encode. If it is already encoded, it is returned.
+NSData *encodeFluoData(NSData *fluoData);
+
+/// Returns the number of scans (16-bit integers) of encoded or unencoded fluorescence data.
+int32_t numberOfScansInFluoData(NSData *_Nullable data);
+
+/// Returns fluorescence data decoded from data returned by ``encodeFluoData``, or the data itself if it is not encoded.
+///
+/// Decoding runs at several hundred megabytes of decoded data per second, hence takes a small fraction of the time needed to read the data from the store.
+NSData *decodeFluoData(NSData *data);
+
+/// Gets the fluorescence levels for a range of scans of encoded or unencoded fluorescence data, only decoding the blocks that overlap the range.
+/// - Parameters:
+///   - data: The encoded or unencoded fluorescence data.
+///   - levels: On output, the fluorescence levels. This buffer must hold at least `count` values.
+///   - firstScan: The first scan of the range.
+///   - count: The number of scans in the range. Scans of the range that are beyond the data are set to 0.
+void getFluoLevelsFromFluoData(NSData *data, int16_t *levels, int firstScan, int count);
+
+/// Gets the fluorescence levels at given scans of encoded or unencoded fluorescence data, only decoding the blocks that contain these scans.
+///
+/// Each block is decoded once if scans are sorted in ascending order.
+/// - Parameters:
+///   - data: The encoded or unencoded fluorescence data.
+///   - scans: The scans, preferably in ascending order.
+///   - count: The number of scans.
+///   - levels: On output, the fluorescence levels at `scans`. This buffer must hold at least `count` values. Levels of scans beyond the data are set to 0.
+void getFluoLevelsAtScansFromFluoData(NSData *data, const int32_t *scans, int count, int16_t *levels);
+
+NS_ASSUME_NONNULL_END
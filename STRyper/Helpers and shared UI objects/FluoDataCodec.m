@@ -0,0 +1,246 @@
+//
+//  FluoDataCodec.m
+//  STRyper
+//
+//  Created by Jean Peccoud on 18/10/2026.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#import "FluoDataCodec.h"
+
+/// The first 4 bytes of encoded data ("STRf" in ASCII).
+static const uint32_t FluoDataMagic = 0x66525453;
+
+static const uint16_t FluoDataVersion = 1;
+
+/// The number of differences between scans that are bit-packed at the same width.
+#define GroupLength 32
+
+/// The number of bytes added after the last block, so that decoding can read 8 bytes at any position of a block.
+static const int tailPadding = 8;
+
+/// The header of encoded fluorescence data, which is followed by the offsets of blocks.
+typedef struct FluoDataHeader {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t blockLength;
+	int32_t nScans;
+	uint32_t reserved;
+} FluoDataHeader;
+
+
+static inline int32_t numberOfBlocks(int32_t nScans) {
+	return (nScans + FluoDataBlockLength - 1) / FluoDataBlockLength;
+}
+
+
+/// Returns the offsets of blocks in encoded data, there being one more offset than blocks (the end of the last block).
+static inline const uint32_t *blockOffsets(const uint8_t *bytes) {
+	return (const uint32_t *)(bytes + sizeof(FluoDataHeader));
+}
+
+
+BOOL isEncodedFluoData(NSData *data) {
+	if(data.length < sizeof(FluoDataHeader) + sizeof(uint32_t)) {
+		return NO;
+	}
+	const FluoDataHeader *header = data.bytes;
+	if(header->magic != FluoDataMagic || header->version != FluoDataVersion ||
+	   header->blockLength != FluoDataBlockLength || header->nScans < 0) {
+		return NO;
+	}
+	int32_t nBlocks = numberOfBlocks(header->nScans);
+	if(data.length < sizeof(FluoDataHeader) + (nBlocks + 1) * sizeof(uint32_t)) {
+		return NO;
+	}
+	return blockOffsets(data.bytes)[nBlocks] + tailPadding == data.length;
+}
+
+
+int32_t numberOfScansInFluoData(NSData *data) {
+	if(isEncodedFluoData(data)) {
+		return ((const FluoDataHeader *)data.bytes)->nScans;
+	}
+	return (int32_t)(data.length / sizeof(int16_t));
+}
+
+
+static inline uint32_t zigzag(int32_t value) {
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+
+static inline int32_t unzigzag(uint32_t value) {
+	return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+
+/// Encodes a block of `n` scans at `output`, and returns the number of bytes written.
+static long encodeBlock(const int16_t *fluo, int n, uint8_t *output) {
+	uint8_t *start = output;
+	memcpy(output, fluo, sizeof(int16_t));
+	output += sizeof(int16_t);
+	for (int group = 1; group < n; group += GroupLength) {
+		uint32_t values[GroupLength] = {0};
+		uint32_t bits = 0;
+		for (int i = 0; i < GroupLength && group + i < n; i++) {
+			values[i] = zigzag(fluo[group + i] - fluo[group + i - 1]);
+			bits |= values[i];
+		}
+		uint8_t width = bits == 0? 0 : 32 - __builtin_clz(bits);
+		*output++ = width;
+		uint64_t buffer = 0;
+		int nBits = 0;
+		for (int i = 0; i < GroupLength; i++) {
+			buffer |= (uint64_t)values[i] << nBits;
+			nBits += width;
+			while(nBits >= 8) {
+				*output++ = (uint8_t)buffer;
+				buffer >>= 8;
+				nBits -= 8;
+			}
+		}
+		/// As there are 32 values per group, the bits of the group fill whole bytes.
+	}
+	return output - start;
+}
+
+
+/// Decodes a block of `n` scans starting at `input` into `fluo`.
+static void decodeBlock(const uint8_t *input, int n, int16_t *fluo) {
+	int16_t level;
+	memcpy(&level, input, sizeof(int16_t));
+	input += sizeof(int16_t);
+	fluo[0] = level;
+	for (int group = 1; group < n; group += GroupLength) {
+		uint8_t width = *input++;
+		int end = MIN(n - group, GroupLength);
+		if(width == 0) {
+			for (int i = 0; i < end; i++) {
+				fluo[group + i] = level;
+			}
+			continue;
+		}
+		uint64_t mask = ((uint64_t)1 << width) - 1;
+		int bitPosition = 0;
+		for (int i = 0; i < end; i++) {
+			uint64_t word;
+			memcpy(&word, input + (bitPosition >> 3), sizeof(uint64_t));
+			level += unzigzag((uint32_t)((word >> (bitPosition & 7)) & mask));
+			fluo[group + i] = level;
+			bitPosition += width;
+		}
+		input += GroupLength * width / 8;
+	}
+}
+
+
+NSData *encodeFluoData(NSData *fluoData) {
+	if(isEncodedFluoData(fluoData)) {
+		return fluoData;
+	}
+	int32_t nScans = (int32_t)(fluoData.length / sizeof(int16_t));
+	int32_t nBlocks = numberOfBlocks(nScans);
+	long headerLength = sizeof(FluoDataHeader) + (nBlocks + 1) * sizeof(uint32_t);
+	/// The worst case is 17 bits per scan plus a byte per group.
+	long maxBlockLength = sizeof(int16_t) + (FluoDataBlockLength / GroupLength) * (1 + GroupLength * 17 / 8);
+	NSMutableData *encodedData = [NSMutableData dataWithLength:headerLength + nBlocks * maxBlockLength + tailPadding];
+	uint8_t *bytes = encodedData.mutableBytes;
+	*(FluoDataHeader *)bytes = (FluoDataHeader){.magic = FluoDataMagic, .version = FluoDataVersion,
+		.blockLength = FluoDataBlockLength, .nScans = nScans};
+	uint32_t *offsets = (uint32_t *)(bytes + sizeof(FluoDataHeader));
+
+	const int16_t *fluo = fluoData.bytes;
+	long offset = headerLength;
+	for (int32_t block = 0; block < nBlocks; block++) {
+		offsets[block] = (uint32_t)offset;
+		int32_t firstScan = block * FluoDataBlockLength;
+		offset += encodeBlock(fluo + firstScan, MIN(FluoDataBlockLength, nScans - firstScan), bytes + offset);
+	}
+	offsets[nBlocks] = (uint32_t)offset;
+	encodedData.length = offset + tailPadding;
+
+	if(encodedData.length >= fluoData.length) {
+		return fluoData;
+	}
+	return encodedData;
+}
+
+
+NSData *decodeFluoData(NSData *data) {
+	if(!isEncodedFluoData(data)) {
+		return data;
+	}
+	const uint8_t *bytes = data.bytes;
+	int32_t nScans = ((const FluoDataHeader *)bytes)->nScans;
+	const uint32_t *offsets = blockOffsets(bytes);
+	NSMutableData *fluoData = [NSMutableData dataWithLength:nScans * sizeof(int16_t)];
+	int16_t *fluo = fluoData.mutableBytes;
+	for (int32_t block = 0; block < numberOfBlocks(nScans); block++) {
+		int32_t firstScan = block * FluoDataBlockLength;
+		decodeBlock(bytes + offsets[block], MIN(FluoDataBlockLength, nScans - firstScan), fluo + firstScan);
+	}
+	return fluoData;
+}
+
+
+void getFluoLevelsFromFluoData(NSData *data, int16_t *levels, int firstScan, int count) {
+	int32_t nScans = numberOfScansInFluoData(data);
+	int start = MAX(0, firstScan), end = MIN(nScans, firstScan + count);
+	memset(levels, 0, count * sizeof(int16_t));
+	if(end <= start) {
+		return;
+	}
+	if(!isEncodedFluoData(data)) {
+		memcpy(levels + (start - firstScan), (const int16_t *)data.bytes + start, (end - start) * sizeof(int16_t));
+		return;
+	}
+	const uint8_t *bytes = data.bytes;
+	const uint32_t *offsets = blockOffsets(bytes);
+	int16_t blockLevels[FluoDataBlockLength];
+	for (int block = start / FluoDataBlockLength; block * FluoDataBlockLength < end; block++) {
+		int blockStart = block * FluoDataBlockLength;
+		int blockEnd = MIN(nScans, blockStart + FluoDataBlockLength);
+		decodeBlock(bytes + offsets[block], blockEnd - blockStart, blockLevels);
+		int copyStart = MAX(start, blockStart), copyEnd = MIN(end, blockEnd);
+		memcpy(levels + (copyStart - firstScan), blockLevels + (copyStart - blockStart), (copyEnd - copyStart) * sizeof(int16_t));
+	}
+}
+
+
+void getFluoLevelsAtScansFromFluoData(NSData *data, const int32_t *scans, int count, int16_t *levels) {
+	int32_t nScans = numberOfScansInFluoData(data);
+	BOOL encoded = isEncodedFluoData(data);
+	const uint8_t *bytes = data.bytes;
+	const uint32_t *offsets = encoded? blockOffsets(bytes) : NULL;
+	int16_t blockLevels[FluoDataBlockLength];
+	int decodedBlock = -1;
+	for (int i = 0; i < count; i++) {
+		int32_t scan = scans[i];
+		if(scan < 0 || scan >= nScans) {
+			levels[i] = 0;
+		} else if(!encoded) {
+			levels[i] = ((const int16_t *)bytes)[scan];
+		} else {
+			int block = scan / FluoDataBlockLength;
+			if(block != decodedBlock) {
+				int blockStart = block * FluoDataBlockLength;
+				decodeBlock(bytes + offsets[block], MIN(nScans, blockStart + FluoDataBlockLength) - blockStart, blockLevels);
+				decodedBlock = block;
+			}
+			levels[i] = blockLevels[scan - block * FluoDataBlockLength];
+		}
+	}
+}
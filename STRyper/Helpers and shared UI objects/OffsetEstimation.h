@@ -0,0 +1,63 @@
+//
+//  OffsetEstimation.h
+//  STRyper
+//
+//  Created by Jean Peccoud on 18/10/2026.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+@import Foundation;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// The distance in base pairs between successive points of the fluorescence profiles used to estimate offsets.
+extern const float OffsetProfileStep;
+
+/// Fills a fluorescence profile whose points are regularly spaced in base pairs, by linear interpolation of fluorescence levels at scans.
+///
+/// Points that are outside the range of the `sizes` array are set to 0, as are negative fluorescence levels.
+/// - Parameters:
+///   - profile: The profile to fill, which must contain `length` values.
+///   - length: The number of points of the profile.
+///   - startSize: The size in base pairs of the first point of the profile. Points are ``OffsetProfileStep`` apart.
+///   - fluo: The fluorescence levels of scans.
+///   - sizes: The sizes in base pairs of the scans, which must increase.
+///   - nScans: The number of scans in `fluo` and `sizes`.
+void fillOffsetProfile(float *profile, int length, float startSize, const int16_t *fluo, const float *sizes, int nScans);
+
+/// Estimates the shifts between fluorescence profiles by cross-correlating each profile against their consensus.
+///
+/// Profiles are centered and scaled to unit norm, and their mean makes a first consensus.
+/// Each profile is cross-correlated with the consensus over lags of at most `maxLag` points,
+/// and the shift is the lag maximizing the correlation, refined by parabolic interpolation.
+/// The consensus is then rebuilt from profiles aligned on their shifts, and shifts are estimated again.
+///
+/// Only profiles whose correlation with the consensus is at least half the median correlation contribute to the refined consensus.
+/// As the consensus is itself an average of shifted profiles, shifts are finally centered on their median among these profiles,
+/// so that a typical profile has no shift.
+///
+/// The correlation is computed over the points that are more than `maxLag` from the ends of profiles,
+/// which should therefore cover the region of interest extended by `maxLag` points on each side.
+/// - Parameters:
+///   - profiles: The profiles, one after the other.
+///   - nProfiles: The number of profiles.
+///   - length: The number of points of each profile, which must be more than twice `maxLag`.
+///   - maxLag: The maximum shift to consider, in number of points.
+///   - shifts: On output, the shift of each profile in base pairs, which is positive if features of the profile are at larger sizes than in the consensus.
+///   - scores: On output, the correlation of each profile with the consensus at its shift, divided by the median correlation among profiles.
+///   A score lower than 0.5 denotes a profile that differs from most others, whose shift is unreliable. A profile that has no variation gets a score of 0.
+void estimateProfileShifts(const float *profiles, int nProfiles, int length, int maxLag, float *shifts, float *scores);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,194 @@
+//
+//  OffsetEstimation.m
+//  STRyper
+//
+//  Created by Jean Peccoud on 18/10/2026.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#import "OffsetEstimation.h"
+@import Accelerate;
+
+const float OffsetProfileStep = 0.2;
+
+/// The minimum correlation with the consensus, relative to the median correlation, for a profile to contribute to the refined consensus and to the centering of shifts.
+static const float minRelativeScore = 0.5;
+
+/// The number of times the consensus is rebuilt from aligned profiles.
+static const int nRefinements = 2;
+
+
+void fillOffsetProfile(float *profile, int length, float startSize, const int16_t *fluo, const float *sizes, int nScans) {
+	int scan = 0;
+	for (int i = 0; i < length; i++) {
+		float size = startSize + i * OffsetProfileStep;
+		while(scan < nScans && sizes[scan] < size) {
+			scan++;
+		}
+		if(scan == 0 || scan >= nScans) {
+			profile[i] = 0;
+			continue;
+		}
+		/// The size is between those of the previous scan and this scan.
+		float previousSize = sizes[scan-1];
+		float width = sizes[scan] - previousSize;
+		float ratio = width > 0? (size - previousSize) / width : 0;
+		float value = fluo[scan-1] + ratio * (fluo[scan] - fluo[scan-1]);
+		profile[i] = value > 0? value : 0;
+	}
+}
+
+
+/// Centers a profile and scales it to unit norm. Returns false if the profile has no variation, in which case it is set to 0.
+static bool normalizeProfile(float *profile, int length) {
+	float mean = 0;
+	vDSP_meanv(profile, 1, &mean, length);
+	mean = -mean;
+	vDSP_vsadd(profile, 1, &mean, profile, 1, length);
+	float sumOfSquares = 0;
+	vDSP_svesq(profile, 1, &sumOfSquares, length);
+	if(sumOfSquares <= 0) {
+		vDSP_vclr(profile, 1, length);
+		return false;
+	}
+	float scale = 1/sqrtf(sumOfSquares);
+	vDSP_vsmul(profile, 1, &scale, profile, 1, length);
+	return true;
+}
+
+
+/// Returns the lag in number of points at which a profile correlates best with a consensus, and the correlation at this lag.
+///
+/// `correlations` must have room for `2*maxLag + 1` values.
+static float bestLag(const float *profile, const float *consensus, int length, int maxLag, float *correlations, float *score) {
+	int nLags = 2*maxLag + 1;
+	/// correlations[n] is the sum of profile[i + n - maxLag] * consensus[i] for i in [maxLag, length - maxLag).
+	vDSP_conv(profile, 1, consensus + maxLag, 1, correlations, 1, nLags, length - 2*maxLag);
+	float max = 0;
+	vDSP_Length best = 0;
+	vDSP_maxvi(correlations, 1, &max, &best, nLags);
+	*score = max;
+	float lag = (float)best - maxLag;
+	if(best > 0 && best < nLags-1) {
+		/// We refine the lag by fitting a parabola to the correlations around the maximum.
+		float left = correlations[best-1], right = correlations[best+1];
+		float curvature = left - 2*max + right;
+		if(curvature < 0) {
+			lag += 0.5 * (left - right) / curvature;
+		}
+	}
+	return lag;
+}
+
+
+/// Replaces the consensus by the mean of profiles that correlate with it at least as much as `minScore`, after aligning profiles on their lags.
+static void rebuildConsensus(float *consensus, const float *normalized, int nProfiles, int length, const float *lags, const float *scores, float minScore) {
+	vDSP_vclr(consensus, 1, length);
+	for (int i = 0; i < nProfiles; i++) {
+		if(scores[i] < minScore || scores[i] <= 0) {
+			continue;
+		}
+		const float *profile = normalized + (long)i * length;
+		int lag = (int)roundf(lags[i]);
+		/// consensus[j] receives profile[j + lag].
+		int start = MAX(0, -lag), end = MIN(length, length - lag);
+		if(end > start) {
+			vDSP_vadd(consensus + start, 1, profile + start + lag, 1, consensus + start, 1, end - start);
+		}
+	}
+	normalizeProfile(consensus, length);
+}
+
+
+static int compareFloats(const void *a, const void *b) {
+	float x = *(const float *)a, y = *(const float *)b;
+	return (x > y) - (x < y);
+}
+
+
+/// Returns the median of the values whose score is at least `minScore` and positive, or 0 if there is none.
+/// `buffer` must have room for `n` values.
+static float medianOfScoredValues(const float *values, const float *scores, int n, float minScore, float *buffer) {
+	int nRetained = 0;
+	for (int i = 0; i < n; i++) {
+		if(scores[i] >= minScore && scores[i] > 0) {
+			buffer[nRetained++] = values[i];
+		}
+	}
+	if(nRetained == 0) {
+		return 0;
+	}
+	qsort(buffer, nRetained, sizeof(float), compareFloats);
+	return nRetained % 2 == 1? buffer[nRetained/2] : (buffer[nRetained/2 - 1] + buffer[nRetained/2]) / 2;
+}
+
+
+void estimateProfileShifts(const float *profiles, int nProfiles, int length, int maxLag, float *shifts, float *scores) {
+	if(nProfiles <= 0) {
+		return;
+	}
+	if(length <= 2*maxLag) {
+		vDSP_vclr(shifts, 1, nProfiles);
+		vDSP_vclr(scores, 1, nProfiles);
+		return;
+	}
+
+	float *normalized = malloc((long)nProfiles * length * sizeof(float));
+	memcpy(normalized, profiles, (long)nProfiles * length * sizeof(float));
+	bool *valid = malloc(nProfiles * sizeof(bool));
+	float *consensus = calloc(length, sizeof(float));
+	for (int i = 0; i < nProfiles; i++) {
+		float *profile = normalized + (long)i * length;
+		valid[i] = normalizeProfile(profile, length);
+		if(valid[i]) {
+			vDSP_vadd(consensus, 1, profile, 1, consensus, 1, length);
+		}
+	}
+	normalizeProfile(consensus, length);
+
+	float *correlations = malloc((2*maxLag + 1) * sizeof(float));
+	float *buffer = malloc(nProfiles * sizeof(float));
+	float medianScore = 0;
+	for (int pass = 0; pass <= nRefinements; pass++) {
+		if(pass > 0) {
+			rebuildConsensus(consensus, normalized, nProfiles, length, shifts, scores, minRelativeScore * medianScore);
+		}
+		for (int i = 0; i < nProfiles; i++) {
+			if(valid[i]) {
+				shifts[i] = bestLag(normalized + (long)i * length, consensus, length, maxLag, correlations, &scores[i]);
+			} else {
+				shifts[i] = 0;
+				scores[i] = 0;
+			}
+		}
+		medianScore = medianOfScoredValues(scores, scores, nProfiles, 0, buffer);
+	}
+
+	/// We express scores relative to the median score, and center shifts on their median among profiles that match the consensus.
+	if(medianScore > 0) {
+		float scale = 1/medianScore;
+		vDSP_vsmul(scores, 1, &scale, scores, 1, nProfiles);
+	}
+	float median = medianOfScoredValues(shifts, scores, nProfiles, minRelativeScore, buffer);
+	for (int i = 0; i < nProfiles; i++) {
+		shifts[i] = (shifts[i] - median) * OffsetProfileStep;
+	}
+
+	free(buffer);
+	free(correlations);
+	free(consensus);
+	free(valid);
+	free(normalized);
+}
@@ -0,0 +1,59 @@
+//
+//  SizeArrayCache.h
+//  STRyper
+//
+//  Created by Jean Peccoud on 18/10/2026.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+@import Foundation;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// A cache that stores the ``Chromatogram/sizes`` of samples, which are arrays of floats that can take a lot of memory.
+///
+/// Arrays are identified by the sizing coefficients and the number of scans they derive from,
+/// so that samples that have the same sizing share the same array.
+///
+/// Arrays are retained by the ``DataCache``, which limits the memory they take with that of other cached data.
+/// An array that the ``DataCache`` releases is removed from this cache.
+///
+/// The methods of this class are thread-safe.
+@interface SizeArrayCache : NSObject
+
+/// The cache used by ``Chromatogram`` objects.
+@property (class, readonly) SizeArrayCache *sharedCache;
+
+/// Returns the array of sizes that was stored for sizing coefficients and a number of scans, or `nil` if there is none.
+///
+/// The array returned becomes the most recently used in the ``DataCache``.
+/// - Parameters:
+///   - coefs: The sizing coefficients (see ``Chromatogram/coefs``).
+///   - nScans: The number of scans of the sample.
+- (nullable NSData *)sizesForCoefs:(NSData *)coefs nScans:(int)nScans;
+
+/// Stores an array of sizes for sizing coefficients and a number of scans, and adds it to the ``DataCache``.
+/// - Parameters:
+///   - sizes: The array of sizes, which must contain `nScans` floats.
+///   - coefs: The sizing coefficients from which `sizes` were computed.
+///   - nScans: The number of scans of the sample.
+- (void)setSizes:(NSData *)sizes forCoefs:(NSData *)coefs nScans:(int)nScans;
+
+/// Removes all arrays from the cache.
+- (void)removeAllSizes;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,91 @@
+//
+//  SizeArrayCache.m
+//  STRyper
+//
+//  Created by Jean Peccoud on 18/10/2026.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#import "SizeArrayCache.h"
+#import "DataCache.h"
+
+@implementation SizeArrayCache {
+	/// The arrays of sizes, keyed by the sizing coefficients followed by the number of scans.
+	/// Values are weak references, as arrays are retained by the ``DataCache``.
+	NSMapTable<NSData *, NSData *> *sizeArrays;
+}
+
+
++ (SizeArrayCache *)sharedCache {
+	static SizeArrayCache *sharedCache = nil;
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		sharedCache = self.new;
+	});
+	return sharedCache;
+}
+
+
+- (instancetype)init {
+	self = [super init];
+	if (self) {
+		sizeArrays = NSMapTable.strongToWeakObjectsMapTable;
+	}
+	return self;
+}
+
+/// Returns the key identifying sizes computed from sizing coefficients and a number of scans.
+static NSData *keyForCoefs(NSData *coefs, int nScans) {
+	NSMutableData *key = [NSMutableData dataWithData:coefs];
+	[key appendBytes:&nScans length:sizeof(nScans)];
+	return key;
+}
+
+
+- (nullable NSData *)sizesForCoefs:(NSData *)coefs nScans:(int)nScans {
+	NSData *key = keyForCoefs(coefs, nScans);
+	NSData *sizes;
+	@synchronized (self) {
+		sizes = [sizeArrays objectForKey:key];
+	}
+	[DataCache.sharedCache useData:sizes];
+	return sizes;
+}
+
+
+- (void)setSizes:(NSData *)sizes forCoefs:(NSData *)coefs nScans:(int)nScans {
+	NSData *key = keyForCoefs(coefs, nScans);
+	@synchronized (self) {
+		NSData *previousSizes = [sizeArrays objectForKey:key];
+		if(previousSizes != sizes) {
+			[DataCache.sharedCache removeData:previousSizes];
+		}
+		[sizeArrays setObject:sizes forKey:key];
+	}
+	[DataCache.sharedCache addData:sizes category:DataCacheCategorySizes];
+}
+
+
+- (void)removeAllSizes {
+	@synchronized (self) {
+		DataCache *dataCache = DataCache.sharedCache;
+		for(NSData *sizes in sizeArrays.objectEnumerator) {
+			[dataCache removeData:sizes];
+		}
+		[sizeArrays removeAllObjects];
+	}
+}
+
+@end
@@ -0,0 +1,110 @@
+//
+//  StutterStatistics.h
+//  STRyper
+//
+//  Created by Jean Peccoud on 18/10/2026.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#import "Trace.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// The height ratios described by ``StutterStatistics``.
+typedef NS_ENUM(int32_t, StutterRatio) {
+	/// The height of the peak one repeat shorter than an allele, relative to the allele peak.
+	StutterRatioMinusOne,
+
+	/// The height of the peak one repeat longer than an allele, relative to the allele peak.
+	StutterRatioPlusOne,
+
+	/// The height of the peak two repeats shorter than an allele, relative to the allele peak.
+	StutterRatioMinusTwo,
+
+	/// The height of the peak one base pair shorter than an allele (lacking the non-templated adenine), relative to the allele peak.
+	StutterRatioAdenylation,
+
+	/// The height of the longer allele relative to the shorter allele, for heterozygotes.
+	StutterRatioHeterozygoteBalance,
+
+	/// The number of ratios.
+	StutterRatioCount
+};
+
+/// The number of classes of the histograms of ``StutterStatistics``.
+///
+/// Classes are 0.01 wide, from 0 to 2. Higher ratios are counted in the last class.
+#define StutterRatioClasses 200
+
+/// A structure that summarizes the distributions of stutter ratios, adenylation ratios and heterozygote balance at a marker.
+///
+/// Ratios are counted in histograms, which can be filled in a single pass over genotypes and take constant space.
+/// Quantiles are obtained with ``stutterRatioQuantile``.
+/// A ratio is 0 if no peak was found at the expected position.
+typedef struct StutterStatistics {
+	/// The number of genotypes whose ratios were counted.
+	uint32_t nGenotypes;
+
+	/// The histograms of ratios, by ``StutterRatio``.
+	uint32_t counts[StutterRatioCount][StutterRatioClasses];
+} StutterStatistics;
+
+
+/// Adds the ratios measured for a genotype to stutter statistics.
+///
+/// Neighbors of alleles are peaks whose size is within 0.5 bp of the expected position.
+/// Stutter ratios are only counted for homozygotes and for genotypes whose alleles are more than three repeats apart,
+/// where stutter peaks cannot be confused with alleles.
+/// - Parameters:
+///   - statistics: The statistics to update.
+///   - peaks: The annotated peaks in the range of the marker (see ``FluoTrace/annotatedPeaks``), sorted by size.
+///   - nPeaks: The number of peaks.
+///   - alleleScans: The scans of the genotype's alleles. Alleles that do not correspond to a peak are ignored.
+///   - nAlleles: The number of alleles.
+///   - motiveLength: The length of the repeat motive of the marker, in base pairs.
+void addGenotypeToStutterStatistics(StutterStatistics *statistics, const AnnotatedPeak *peaks, int nPeaks, const int32_t *alleleScans, int nAlleles, int motiveLength);
+
+/// Returns the ratio below which a fraction of the ratios of a given type fall, or -1 if no ratio of this type was counted.
+///
+/// The returned value is the upper bound of the histogram class containing the quantile.
+/// - Parameters:
+///   - statistics: The statistics.
+///   - ratio: The type of ratio.
+///   - fraction: The fraction of ratios (e.g. 0.5 for the median).
+float stutterRatioQuantile(const StutterStatistics *statistics, StutterRatio ratio, float fraction);
+
+/// Returns the number of ratios of a given type that were counted.
+uint32_t numberOfStutterRatios(const StutterStatistics *statistics, StutterRatio ratio);
+
+/// Returns a robust upper bound of the ratios of a given type, or -1 if no ratio of this type was counted.
+///
+/// The bound is the median plus three times the scaled median absolute deviation (MAD) of the ratios,
+/// so that it is not influenced by a minority of high ratios, such as those of alleles that were not called.
+/// - Parameters:
+///   - statistics: The statistics.
+///   - ratio: The type of ratio.
+float stutterRatioUpperBound(const StutterStatistics *statistics, StutterRatio ratio);
+
+/// Raises the height ratios that a peak must exceed to be considered as an allele during allele calling, if stutter peaks are higher at a marker.
+///
+/// A threshold is set to the ``stutterRatioUpperBound`` of the corresponding stutter ratio, if this is higher than the threshold.
+/// Thresholds are not modified if fewer than 100 ratios were counted, and are raised at most to 0.9 (shorter peaks) and 0.6 (longer peaks).
+/// - Parameters:
+///   - statistics: The statistics of the marker.
+///   - leftMaxDropOut: The minimum height ratio of a peak that is one repeat shorter than an allele, which may be modified.
+///   - rightMaxDropOut: The minimum height ratio of a peak that is one repeat longer than an allele, which may be modified.
+void adjustDropOutRatiosToStutterStatistics(const StutterStatistics *statistics, float *leftMaxDropOut, float *rightMaxDropOut);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,218 @@
+//
+//  StutterStatistics.m
+//  STRyper
+//
+//  Created by Jean Peccoud on 18/10/2026.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#import "StutterStatistics.h"
+
+/// The maximum difference in base pairs between the size of a peak and the position where a neighbor is expected.
+static const float sizeTolerance = 0.5;
+
+
+static void addRatio(StutterStatistics *statistics, StutterRatio ratio, float value) {
+	int index = (int)(value * 100);
+	if(index < 0) {
+		index = 0;
+	} else if(index >= StutterRatioClasses) {
+		index = StutterRatioClasses - 1;
+	}
+	statistics->counts[ratio][index]++;
+}
+
+
+/// Returns the index of the peak whose tip is at a scan, or -1 if there is none.
+static int peakIndexForScan(const AnnotatedPeak *peaks, int nPeaks, int32_t scan) {
+	int low = 0, high = nPeaks;
+	while(low < high) {
+		int mid = (low + high) / 2;
+		if(peaks[mid].scan < scan) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return low < nPeaks && peaks[low].scan == scan? low : -1;
+}
+
+
+/// Returns the highest relative height among peaks whose size is close to a given size, or 0 if there is none.
+static float neighborHeight(const AnnotatedPeak *peaks, int nPeaks, int peakIndex, float size) {
+	float height = 0;
+	int increment = size < peaks[peakIndex].size? -1 : 1;
+	for (int i = peakIndex + increment; i >= 0 && i < nPeaks; i += increment) {
+		float diff = peaks[i].size - size;
+		if(diff * increment > sizeTolerance) {
+			break;
+		}
+		if(fabsf(diff) <= sizeTolerance && peaks[i].relativeHeight > height) {
+			height = peaks[i].relativeHeight;
+		}
+	}
+	return height;
+}
+
+
+void addGenotypeToStutterStatistics(StutterStatistics *statistics, const AnnotatedPeak *peaks, int nPeaks, const int32_t *alleleScans, int nAlleles, int motiveLength) {
+	/// We find the peaks of alleles, ignoring a second allele at the same peak (homozygotes).
+	int alleleIndices[nAlleles];
+	int nAllelePeaks = 0;
+	for (int i = 0; i < nAlleles; i++) {
+		int index = peakIndexForScan(peaks, nPeaks, alleleScans[i]);
+		if(index >= 0 && peaks[index].relativeHeight > 0) {
+			bool found = false;
+			for (int j = 0; j < nAllelePeaks; j++) {
+				if(alleleIndices[j] == index) {
+					found = true;
+					break;
+				}
+			}
+			if(!found) {
+				alleleIndices[nAllelePeaks++] = index;
+			}
+		}
+	}
+	if(nAllelePeaks == 0) {
+		return;
+	}
+	statistics->nGenotypes++;
+	
+	/// Stutter ratios are only measured if no allele is close enough to the stutter positions of another allele,
+	/// as the stutter peak of an allele cannot be told apart from an allele there (nor from its stutter peaks).
+	bool separated = true;
+	for (int i = 0; i < nAllelePeaks && separated; i++) {
+		for (int j = i+1; j < nAllelePeaks; j++) {
+			if(fabsf(peaks[alleleIndices[i]].size - peaks[alleleIndices[j]].size) <= 3 * motiveLength + sizeTolerance) {
+				separated = false;
+				break;
+			}
+		}
+	}
+
+	static const int stutterOffsets[] = {-1, 1, -2};
+	static const StutterRatio stutterRatios[] = {StutterRatioMinusOne, StutterRatioPlusOne, StutterRatioMinusTwo};
+
+	for (int i = 0; i < nAllelePeaks; i++) {
+		const AnnotatedPeak *allelePeak = &peaks[alleleIndices[i]];
+		float height = allelePeak->relativeHeight;
+		if(separated) {
+			for (int j = 0; j < 3; j++) {
+				float stutterSize = allelePeak->size + stutterOffsets[j] * motiveLength;
+				addRatio(statistics, stutterRatios[j], neighborHeight(peaks, nPeaks, alleleIndices[i], stutterSize) / height);
+			}
+		}
+		addRatio(statistics, StutterRatioAdenylation, neighborHeight(peaks, nPeaks, alleleIndices[i], allelePeak->size - 1) / height);
+	}
+
+	if(nAllelePeaks == 2) {
+		const AnnotatedPeak *peak1 = &peaks[alleleIndices[0]], *peak2 = &peaks[alleleIndices[1]];
+		if(peak1->size > peak2->size) {
+			const AnnotatedPeak *temp = peak1;
+			peak1 = peak2;
+			peak2 = temp;
+		}
+		addRatio(statistics, StutterRatioHeterozygoteBalance, (float)peak2->relativeHeight / peak1->relativeHeight);
+	}
+}
+
+
+uint32_t numberOfStutterRatios(const StutterStatistics *statistics, StutterRatio ratio) {
+	uint32_t total = 0;
+	for (int i = 0; i < StutterRatioClasses; i++) {
+		total += statistics->counts[ratio][i];
+	}
+	return total;
+}
+
+
+float stutterRatioQuantile(const StutterStatistics *statistics, StutterRatio ratio, float fraction) {
+	uint32_t total = numberOfStutterRatios(statistics, ratio);
+	if(total == 0) {
+		return -1;
+	}
+	uint64_t target = MAX(1, ceilf(total * fraction));
+	uint64_t cumul = 0;
+	for (int i = 0; i < StutterRatioClasses; i++) {
+		cumul += statistics->counts[ratio][i];
+		if(cumul >= target) {
+			return (i + 1) / 100.0;
+		}
+	}
+	return StutterRatioClasses / 100.0;
+}
+
+
+/// Returns the weighted median of values, given their counts. `indices` is used as a buffer.
+static float weightedMedian(const float *values, const uint32_t *counts, int n, uint32_t total, int *indices) {
+	for (int i = 0; i < n; i++) {
+		indices[i] = i;
+	}
+	/// Insertion sort, as there are few values, which are often already sorted.
+	for (int i = 1; i < n; i++) {
+		int index = indices[i];
+		int j = i - 1;
+		while(j >= 0 && values[indices[j]] > values[index]) {
+			indices[j+1] = indices[j];
+			j--;
+		}
+		indices[j+1] = index;
+	}
+	uint64_t cumul = 0;
+	for (int i = 0; i < n; i++) {
+		cumul += counts[indices[i]];
+		if(cumul * 2 >= total) {
+			return values[indices[i]];
+		}
+	}
+	return values[indices[n-1]];
+}
+
+
+float stutterRatioUpperBound(const StutterStatistics *statistics, StutterRatio ratio) {
+	uint32_t total = numberOfStutterRatios(statistics, ratio);
+	if(total == 0) {
+		return -1;
+	}
+	const uint32_t *counts = statistics->counts[ratio];
+	float values[StutterRatioClasses], deviations[StutterRatioClasses];
+	int indices[StutterRatioClasses];
+	for (int i = 0; i < StutterRatioClasses; i++) {
+		values[i] = (i + 0.5) / 100.0;	/// The center of the class
+	}
+	float median = weightedMedian(values, counts, StutterRatioClasses, total, indices);
+	for (int i = 0; i < StutterRatioClasses; i++) {
+		deviations[i] = fabsf(values[i] - median);
+	}
+	/// The median absolute deviation cannot be resolved below the width of a class.
+	float MAD = MAX(0.01, weightedMedian(deviations, counts, StutterRatioClasses, total, indices));
+	/// The MAD is scaled to estimate the standard deviation of a normal distribution.
+	return median + 3 * 1.4826 * MAD;
+}
+
+
+void adjustDropOutRatiosToStutterStatistics(const StutterStatistics *statistics, float *leftMaxDropOut, float *rightMaxDropOut) {
+	/// The bound is robust to the high ratios given by alleles that were not called (for instance, a heterozygote allele one repeat shorter
+	/// that fell below the threshold), so a threshold that was raised does not raise itself further when genotypes are called again.
+	if(numberOfStutterRatios(statistics, StutterRatioMinusOne) >= 100) {
+		float ratio = stutterRatioUpperBound(statistics, StutterRatioMinusOne);
+		*leftMaxDropOut = MIN(0.9, MAX(*leftMaxDropOut, ratio));
+	}
+	if(numberOfStutterRatios(statistics, StutterRatioPlusOne) >= 100) {
+		float ratio = stutterRatioUpperBound(statistics, StutterRatioPlusOne);
+		*rightMaxDropOut = MIN(0.6, MAX(*rightMaxDropOut, ratio));
+	}
+}
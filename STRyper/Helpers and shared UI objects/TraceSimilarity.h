@@ -0,0 +1,91 @@
+//
+//  TraceSimilarity.h
+//  STRyper
+//
+//  Created by Jean Peccoud on 18/10/2026.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+@import Foundation;
+
+@class Chromatogram;
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// The number of values composing the signature of a sample, see ``computeSimilaritySignature``.
+#define SimilaritySignatureLength 120
+
+/// Two samples that may be duplicates, found by ``findSimilarSamples``.
+typedef struct SimilarSamplePair {
+	/// The index of the first sample, which is lower than `sample2`.
+	int32_t sample1;
+
+	/// The index of the second sample.
+	int32_t sample2;
+
+	/// The Jaccard index of the token sets of the two samples: the number of shared tokens divided by the number of distinct tokens.
+	float similarity;
+
+	/// The number of shared tokens divided by the number of tokens of the sample having the fewest.
+	///
+	/// A containment much higher than the `similarity` denotes a sample whose peaks are included in those of the other, as in a contamination.
+	float containment;
+} SimilarSamplePair;
+
+
+/// Computes a MinHash signature of a set of tokens, such that the fraction of equal values between two signatures estimates the Jaccard index of the sets.
+///
+/// A single hash function is used: each token is hashed once and placed in one of ``SimilaritySignatureLength`` bins, which retain the minimum hash they receive.
+/// Bins that receive no token take the value of a non-empty bin chosen by hashing, which preserves the estimation of the Jaccard index for small sets.
+/// - Parameters:
+///   - tokens: The tokens of the set.
+///   - nTokens: The number of tokens. If 0, all values of the signature are set to 0.
+///   - signature: On output, the signature, which must have room for ``SimilaritySignatureLength`` values.
+void computeSimilaritySignature(const uint32_t *tokens, int nTokens, uint32_t *signature);
+
+
+/// Finds pairs of samples whose token sets are similar, without comparing every pair.
+///
+/// Signatures are split into bands of consecutive values, and samples whose signatures have the same values in a band become candidates (locality-sensitive hashing).
+/// Bands are such that two samples whose Jaccard index is 0.7 have 99% chances to become candidates, against less than 1% for an index of 0.2.
+/// The Jaccard index and the containment of candidates are then computed from their tokens, considering that tokens differing by 1 are shared.
+///
+/// Samples having no token are ignored, as are groups of more than 200 samples having the same values in a band, which result from degenerate token sets.
+/// - Parameters:
+///   - signatures: The signatures of samples, one after the other, computed by ``computeSimilaritySignature``.
+///   - tokens: The tokens of samples, one after the other. The tokens of a sample must be sorted in ascending order, without duplicates.
+///   - tokenStarts: The index in `tokens` of the first token of each sample. The array must contain `nSamples + 1` values, the last being the total number of tokens.
+///   - nSamples: The number of samples.
+///   - minSimilarity: The minimum Jaccard index of a pair of samples to be returned. A pair whose containment is at least 0.9 is also returned.
+/// - Returns: An array of ``SimilarSamplePair`` structs sorted by decreasing `similarity`.
+NSData *findSimilarSamples(const uint32_t *signatures, const uint32_t *tokens, const long *tokenStarts, int nSamples, float minSimilarity);
+
+
+/// Returns a tab-delimited report of samples that may be duplicates or contaminated, found with ``findSimilarSamples``.
+///
+/// The tokens of a sample combine the channel and the size, rounded to the base pair, of the 40 highest peaks of each channel except the ladder.
+/// Peaks resulting from crosstalk or lower than 5% of the highest peak of the channel are ignored, as are samples that are not sized.
+/// Tokens that more than half of the samples have are not used, as they do not discriminate samples.
+///
+/// Fluorescence levels and sizes are only read at the tips of peaks, so that traces are not decoded.
+///
+/// This function can take a while for many samples. It can be called on any thread, but the samples must belong to the context of this thread.
+/// - Parameters:
+///   - samples: The samples to compare.
+///   - minSimilarity: The minimum similarity between samples to report.
+///   - progress: A progress that the function sets and updates as tokens are read from samples. If it is cancelled, the function returns `nil`.
+NSString *_Nullable similarityReportForSamples(NSArray<Chromatogram *> *samples, float minSimilarity, NSProgress *_Nullable progress);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,399 @@
+//
+//  TraceSimilarity.m
+//  STRyper
+//
+//  Created by Jean Peccoud on 18/10/2026.
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+
+#import "TraceSimilarity.h"
+#import "Chromatogram.h"
+#import "Trace.h"
+
+/// The number of bands of the signature used for locality-sensitive hashing.
+#define nBands 24
+
+/// The number of signature values per band.
+#define rowsPerBand (SimilaritySignatureLength / nBands)
+
+/// The maximum number of samples having the same values in a band for these samples to become candidates.
+static const int maxBucketSize = 200;
+
+/// The number of highest peaks per channel that make the tokens of a sample.
+static const int maxPeaksPerChannel = 40;
+
+/// The height of a peak relative to the highest peak of its channel, under which the peak makes no token.
+static const float minRelativePeakHeight = 0.05;
+
+/// The maximum fraction of samples that can have a token for the token to be used in comparisons.
+static const float maxTokenFrequency = 0.5;
+
+/// An upper bound on the value of a token.
+#define TokenValueLimit (1 << 15)
+
+
+/// Mixes the bits of a 64-bit key.
+static inline uint64_t mixKey(uint64_t key) {
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return key;
+}
+
+
+void computeSimilaritySignature(const uint32_t *tokens, int nTokens, uint32_t *signature) {
+	if(nTokens <= 0) {
+		memset(signature, 0, SimilaritySignatureLength * sizeof(uint32_t));
+		return;
+	}
+	bool filled[SimilaritySignatureLength];
+	for (int i = 0; i < SimilaritySignatureLength; i++) {
+		signature[i] = UINT32_MAX;
+		filled[i] = false;
+	}
+	for (int i = 0; i < nTokens; i++) {
+		uint64_t hash = mixKey(tokens[i] ^ 0x9e3779b97f4a7c15ULL);
+		/// The upper bits of the hash give the bin, the lower bits its value.
+		int bin = (int)(((hash >> 32) * SimilaritySignatureLength) >> 32);
+		uint32_t value = (uint32_t)hash;
+		if(value < signature[bin]) {
+			signature[bin] = value;
+		}
+		filled[bin] = true;
+	}
+	/// Each empty bin takes the value of a non-empty bin found by a sequence of probes that only depends on the empty bin,
+	/// so that different empty bins take values from independent bins, and two signatures take the same value if the probed bin is filled in both.
+	for (int i = 0; i < SimilaritySignatureLength; i++) {
+		if(!filled[i]) {
+			uint64_t probe = i;
+			int bin;
+			do {
+				probe = mixKey(probe + 0x9e3779b97f4a7c15ULL);
+				bin = (int)(((probe >> 32) * SimilaritySignatureLength) >> 32);
+			} while(!filled[bin]);
+			signature[i] = signature[bin];
+		}
+	}
+}
+
+
+typedef struct BandEntry {
+	uint64_t hash;
+	int32_t sample;
+} BandEntry;
+
+
+static int compareBandEntries(const void *a, const void *b) {
+	uint64_t hash1 = ((const BandEntry *)a)->hash, hash2 = ((const BandEntry *)b)->hash;
+	return (hash1 > hash2) - (hash1 < hash2);
+}
+
+
+static int compareKeys(const void *a, const void *b) {
+	uint64_t key1 = *(const uint64_t *)a, key2 = *(const uint64_t *)b;
+	return (key1 > key2) - (key1 < key2);
+}
+
+
+static int compareSimilarities(const void *a, const void *b) {
+	float similarity1 = ((const SimilarSamplePair *)a)->similarity, similarity2 = ((const SimilarSamplePair *)b)->similarity;
+	return (similarity1 < similarity2) - (similarity1 > similarity2);
+}
+
+
+/// Returns the number of values shared by two sorted arrays without duplicates.
+///
+/// Values that differ by 1 are considered shared, to tolerate the rounding of peak sizes that vary slightly between runs.
+static long sharedTokenCount(const uint32_t *tokens1, long n1, const uint32_t *tokens2, long n2) {
+	long i = 0, j = 0, shared = 0;
+	while(i < n1 && j < n2) {
+		if(tokens1[i] + 1 < tokens2[j]) {
+			i++;
+		} else if(tokens2[j] + 1 < tokens1[i]) {
+			j++;
+		} else {
+			shared++;
+			i++;
+			j++;
+		}
+	}
+	return shared;
+}
+
+
+NSData *findSimilarSamples(const uint32_t *signatures, const uint32_t *tokens, const long *tokenStarts, int nSamples, float minSimilarity) {
+	int32_t *validSamples = malloc(MAX(1, nSamples) * sizeof(int32_t));
+	int nValid = 0;
+	for (int i = 0; i < nSamples; i++) {
+		if(tokenStarts[i+1] > tokenStarts[i]) {
+			validSamples[nValid++] = i;
+		}
+	}
+
+	/// Each band is processed in parallel and produces candidate pairs, encoded as 64-bit keys.
+	uint64_t **bandPairs = malloc(nBands * sizeof(uint64_t *));
+	long *bandPairCounts = malloc(nBands * sizeof(long));
+	dispatch_apply(nBands, DISPATCH_APPLY_AUTO, ^(size_t band) {
+		BandEntry *entries = malloc(MAX(1, nValid) * sizeof(BandEntry));
+		for (int i = 0; i < nValid; i++) {
+			const uint32_t *values = signatures + (long)validSamples[i] * SimilaritySignatureLength + band * rowsPerBand;
+			uint64_t hash = band;
+			for (int row = 0; row < rowsPerBand; row++) {
+				hash = mixKey(hash ^ values[row]) + row;
+			}
+			entries[i] = (BandEntry){.hash = hash, .sample = validSamples[i]};
+		}
+		qsort(entries, nValid, sizeof(BandEntry), compareBandEntries);
+
+		long capacity = 1024, count = 0;
+		uint64_t *pairs = malloc(capacity * sizeof(uint64_t));
+		for (int start = 0, end = 0; start < nValid; start = end) {
+			while(end < nValid && entries[end].hash == entries[start].hash) {
+				end++;
+			}
+			if(end - start < 2 || end - start > maxBucketSize) {
+				continue;
+			}
+			for (int i = start; i < end; i++) {
+				for (int j = i+1; j < end; j++) {
+					if(count == capacity) {
+						capacity *= 2;
+						pairs = realloc(pairs, capacity * sizeof(uint64_t));
+					}
+					int32_t sample1 = MIN(entries[i].sample, entries[j].sample), sample2 = MAX(entries[i].sample, entries[j].sample);
+					pairs[count++] = (uint64_t)sample1 << 32 | (uint32_t)sample2;
+				}
+			}
+		}
+		free(entries);
+		bandPairs[band] = pairs;
+		bandPairCounts[band] = count;
+	});
+	free(validSamples);
+
+	/// Pairs found in several bands are counted once.
+	long nCandidates = 0;
+	for (int band = 0; band < nBands; band++) {
+		nCandidates += bandPairCounts[band];
+	}
+	uint64_t *candidates = malloc(MAX(1, nCandidates) * sizeof(uint64_t));
+	nCandidates = 0;
+	for (int band = 0; band < nBands; band++) {
+		memcpy(candidates + nCandidates, bandPairs[band], bandPairCounts[band] * sizeof(uint64_t));
+		nCandidates += bandPairCounts[band];
+		free(bandPairs[band]);
+	}
+	free(bandPairs);
+	free(bandPairCounts);
+	qsort(candidates, nCandidates, sizeof(uint64_t), compareKeys);
+	long nUnique = 0;
+	for (long i = 0; i < nCandidates; i++) {
+		if(nUnique == 0 || candidates[i] != candidates[nUnique-1]) {
+			candidates[nUnique++] = candidates[i];
+		}
+	}
+
+	/// We compute the similarity of candidates from their tokens, by chunks processed in parallel.
+	SimilarSamplePair *results = malloc(MAX(1, nUnique) * sizeof(SimilarSamplePair));
+	bool *retained = calloc(MAX(1, nUnique), sizeof(bool));
+	const long chunkSize = 4096;
+	long nChunks = (nUnique + chunkSize - 1) / chunkSize;
+	dispatch_apply(nChunks, DISPATCH_APPLY_AUTO, ^(size_t chunk) {
+		long end = MIN(nUnique, (chunk+1) * chunkSize);
+		for (long i = chunk * chunkSize; i < end; i++) {
+			int32_t sample1 = (int32_t)(candidates[i] >> 32), sample2 = (int32_t)(uint32_t)candidates[i];
+			long n1 = tokenStarts[sample1+1] - tokenStarts[sample1], n2 = tokenStarts[sample2+1] - tokenStarts[sample2];
+			long shared = sharedTokenCount(tokens + tokenStarts[sample1], n1, tokens + tokenStarts[sample2], n2);
+			float similarity = (float)shared / (n1 + n2 - shared);
+			float containment = (float)shared / MIN(n1, n2);
+			results[i] = (SimilarSamplePair){.sample1 = sample1, .sample2 = sample2, .similarity = similarity, .containment = containment};
+			retained[i] = similarity >= minSimilarity || containment >= 0.9;
+		}
+	});
+
+	long nRetained = 0;
+	for (long i = 0; i < nUnique; i++) {
+		if(retained[i]) {
+			results[nRetained++] = results[i];
+		}
+	}
+	qsort(results, nRetained, sizeof(SimilarSamplePair), compareSimilarities);
+	NSData *pairData = [NSData dataWithBytes:results length:nRetained * sizeof(SimilarSamplePair)];
+
+	free(retained);
+	free(results);
+	free(candidates);
+	return pairData;
+}
+
+
+/// Removes tokens that more than a given fraction of samples have, as these do not discriminate samples (e.g., peaks of primer dimers) and would make too many candidates.
+///
+/// Tokens are removed only if more than 10 samples have them. Tokens must be lower than ``TokenValueLimit``.
+/// `tokenStarts` is updated to reflect the removal.
+static void removeCommonTokens(uint32_t *tokens, long *tokenStarts, int nSamples, float maxFrequency) {
+	int32_t *counts = calloc(TokenValueLimit, sizeof(int32_t));
+	for (long i = 0; i < tokenStarts[nSamples]; i++) {
+		counts[tokens[i]]++;
+	}
+	int32_t maxCount = MAX(10, maxFrequency * nSamples);
+	long nTokens = 0;
+	for (int sample = 0; sample < nSamples; sample++) {
+		long start = tokenStarts[sample];
+		tokenStarts[sample] = nTokens;
+		for (long i = start; i < tokenStarts[sample+1]; i++) {
+			if(counts[tokens[i]] <= maxCount) {
+				tokens[nTokens++] = tokens[i];
+			}
+		}
+	}
+	tokenStarts[nSamples] = nTokens;
+	free(counts);
+}
+
+
+typedef struct PeakToken {
+	int16_t height;
+	uint32_t token;
+} PeakToken;
+
+
+static int compareHeights(const void *a, const void *b) {
+	int16_t height1 = ((const PeakToken *)a)->height, height2 = ((const PeakToken *)b)->height;
+	return (height1 < height2) - (height1 > height2);
+}
+
+
+static int compareTokens(const void *a, const void *b) {
+	uint32_t token1 = *(const uint32_t *)a, token2 = *(const uint32_t *)b;
+	return (token1 > token2) - (token1 < token2);
+}
+
+
+/// Appends the sorted tokens of a sample to `tokenData` (see ``similarityReportForSamples``).
+static void appendTokensOfSample(Chromatogram *sample, NSMutableData *tokenData) {
+	int nScans = sample.nScans;
+	if(nScans <= 0) {
+		return;
+	}
+	long firstToken = tokenData.length / sizeof(uint32_t);
+
+	for(FluoTrace *trace in sample.traces) {
+		if(trace.isLadder) {
+			continue;
+		}
+		NSData *peakData = trace.peaks;
+		const Peak *peaks = peakData.bytes;
+		long nPeaks = peakData.length / sizeof(Peak);
+		if(nPeaks == 0) {
+			continue;
+		}
+		/// We only read fluorescence and sizes at the tips of peaks, rather than decoding the whole trace.
+		int32_t *tipScans = malloc(nPeaks * sizeof(int32_t));
+		int nTips = 0;
+		for (long i = 0; i < nPeaks; i++) {
+			int32_t scan = peaks[i].startScan + peaks[i].scansToTip;
+			if(peaks[i].crossTalk >= 0 && scan < nScans) {
+				tipScans[nTips++] = scan;
+			}
+		}
+		int16_t *heights = malloc(MAX(1, nTips) * sizeof(int16_t));
+		[trace getFluoLevels:heights atScans:tipScans count:nTips];
+		
+		PeakToken *peakTokens = malloc(MAX(1, nTips) * sizeof(PeakToken));
+		int nPeakTokens = 0;
+		int16_t maxHeight = 0;
+		for (int i = 0; i < nTips; i++) {
+			float size = [sample sizeForScan:tipScans[i]];
+			if(size <= 0) {
+				continue;
+			}
+			uint32_t sizeBin = MIN(4095, (uint32_t)lroundf(size));
+			peakTokens[nPeakTokens++] = (PeakToken){.height = heights[i], .token = (uint32_t)trace.channel << 12 | sizeBin};
+			if(heights[i] > maxHeight) {
+				maxHeight = heights[i];
+			}
+		}
+		qsort(peakTokens, nPeakTokens, sizeof(PeakToken), compareHeights);
+		for (int i = 0; i < MIN(nPeakTokens, maxPeaksPerChannel) && peakTokens[i].height >= maxHeight * minRelativePeakHeight; i++) {
+			[tokenData appendBytes:&peakTokens[i].token length:sizeof(uint32_t)];
+		}
+		free(peakTokens);
+		free(heights);
+		free(tipScans);
+	}
+
+	/// Tokens are sorted, and duplicates (peaks rounded to the same size) are removed.
+	uint32_t *tokens = (uint32_t *)tokenData.mutableBytes + firstToken;
+	long nTokens = tokenData.length / sizeof(uint32_t) - firstToken, nUnique = 0;
+	qsort(tokens, nTokens, sizeof(uint32_t), compareTokens);
+	for (long i = 0; i < nTokens; i++) {
+		if(nUnique == 0 || tokens[i] != tokens[nUnique-1]) {
+			tokens[nUnique++] = tokens[i];
+		}
+	}
+	tokenData.length = (firstToken + nUnique) * sizeof(uint32_t);
+}
+
+
+NSString *similarityReportForSamples(NSArray<Chromatogram *> *samples, float minSimilarity, NSProgress *progress) {
+	progress.totalUnitCount = samples.count;
+	NSMutableArray<Chromatogram *> *comparedSamples = NSMutableArray.new;
+	NSMutableData *tokenData = NSMutableData.new;
+	NSMutableData *tokenStartData = NSMutableData.new;
+	long tokenStart = 0;
+	for(Chromatogram *sample in samples) {
+		if(progress.isCancelled) {
+			return nil;
+		}
+		progress.completedUnitCount++;
+		if(sample.sizingQuality.floatValue <= 0) {
+			continue;
+		}
+		[comparedSamples addObject:sample];
+		[tokenStartData appendBytes:&tokenStart length:sizeof(long)];
+		@autoreleasepool {
+			appendTokensOfSample(sample, tokenData);
+		}
+		tokenStart = tokenData.length / sizeof(uint32_t);
+	}
+	[tokenStartData appendBytes:&tokenStart length:sizeof(long)];
+
+	int nSamples = (int)comparedSamples.count;
+	uint32_t *tokens = tokenData.mutableBytes;
+	long *tokenStarts = tokenStartData.mutableBytes;
+	removeCommonTokens(tokens, tokenStarts, nSamples, maxTokenFrequency);
+	uint32_t *signatures = malloc(MAX(1, nSamples) * SimilaritySignatureLength * sizeof(uint32_t));
+	dispatch_apply(nSamples, DISPATCH_APPLY_AUTO, ^(size_t i) {
+		computeSimilaritySignature(tokens + tokenStarts[i], (int)(tokenStarts[i+1] - tokenStarts[i]),
+								   signatures + i * SimilaritySignatureLength);
+	});
+	NSData *pairData = findSimilarSamples(signatures, tokens, tokenStarts, nSamples, minSimilarity);
+	free(signatures);
+
+	NSMutableArray<NSString *> *rows = NSMutableArray.new;
+	[rows addObject:@"Sample 1\tRun 1\tWell 1\tSample 2\tRun 2\tWell 2\tSimilarity\tContainment"];
+	const SimilarSamplePair *pairs = pairData.bytes;
+	for (long i = 0; i < pairData.length / sizeof(SimilarSamplePair); i++) {
+		Chromatogram *sample1 = comparedSamples[pairs[i].sample1], *sample2 = comparedSamples[pairs[i].sample2];
+		[rows addObject:[NSString stringWithFormat:@"%@\t%@\t%@\t%@\t%@\t%@\t%.3f\t%.3f",
+						 sample1.sampleName, sample1.runName ?: @"", sample1.well ?: @"",
+						 sample2.sampleName, sample2.runName ?: @"", sample2.well ?: @"",
+						 pairs[i].similarity, pairs[i].containment]];
+	}
+	return [rows componentsJoinedByString:@"\n"];
+}
@@ -622,14 +622,7 @@ static CALayer *dragLineLayer;
 				return;
 			}
 			/// else if we are in a marker range, we find an an allele (or alleles) to add to our peak
-			Bin *ourBin;		/// we attach it to the bin at our position, if any
-			float ourSize = self.size;
-			for(Bin *bin in marker.bins) {
-				if(bin.start <= ourSize && bin.end >= ourSize) {
-					ourBin = bin;
-					break;
-				}
-			}
+			Bin *ourBin = [marker binForSize:self.size];		/// we attach it to the bin at our position, if any
 			[self attachAllelesWithBin:ourBin];
 		}
 	}
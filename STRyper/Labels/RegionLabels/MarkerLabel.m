@@ -23,6 +23,8 @@
 #import "MarkerView.h"
 #import "Mmarker.h"
 #import "Bin.h"
+#import "BinClustering.h"
+#import "StutterStatistics.h"
 #import "NewMarkerPopover.h"
 
 static NSPopover *addBinsPopover;	/// The popover that permits to define the set of bins to add to the marker
@@ -372,6 +374,8 @@ static NSImage *actionRoundImage, *actionRoundHoveredImage, *actionCheckImage, *
 		[_menu addItem:NSMenuItem.separatorItem];
 		[_menu addItemWithTitle:@"Generate Bins" action:@selector(spawnAddBinsPopover:) keyEquivalent:@""];
 		_menu.itemArray.lastObject.image = [NSImage imageNamed:ACImageNameBinset];
+		[_menu addItemWithTitle:@"Generate Bins from Alleles" action:@selector(addBinsFromAlleles:) keyEquivalent:@""];
+		_menu.itemArray.lastObject.image = [NSImage imageNamed:ACImageNameBinset];
 		[_menu addItemWithTitle:@"Edit Bins" action:@selector(setEditStateFromMenuItem:) keyEquivalent:@""];
 		_menu.itemArray.lastObject.image = [NSImage imageNamed:ACImageNameEditBins];
 		[_menu.itemArray.lastObject setTag:editStateBins];
@@ -388,6 +392,9 @@ static NSImage *actionRoundImage, *actionRoundHoveredImage, *actionCheckImage, *
 		_menu.itemArray.lastObject.image = [NSImage imageNamed:ACImageNamePasteOffset];
 		[_menu addItemWithTitle:@"Remove Offset" action:@selector(removeOffset:) keyEquivalent:@""];
 		_menu.itemArray.lastObject.image = [NSImage imageNamed:ACImageNameClose];
+		[_menu addItem:NSMenuItem.separatorItem];
+		[_menu addItemWithTitle:@"Stutter Statistics" action:@selector(showStutterStatistics:) keyEquivalent:@""];
+		_menu.itemArray.lastObject.image = [NSImage imageNamed:ACImageNameAllele];
 		
 		for(NSMenuItem *item in self.menu.itemArray) {
 			if(!item.submenu) {
@@ -844,6 +851,100 @@ enum addBinPopoverTag : NSInteger {
 
 
 
+/// Replaces the bins of our marker by bins proposed from the sizes of its alleles, and reports bins that the user should check.
+-(void)addBinsFromAlleles:(id)sender {
+	Mmarker *marker = self.region;
+	NSData *proposedBinData = marker.proposedBinsFromAlleleSizes;
+	long nBins = proposedBinData.length / sizeof(ProposedBin);
+	if(nBins == 0) {
+		NSError *error = [NSError errorWithDescription:@"No bin could be generated because no cluster of allele sizes was found in the marker range."
+											suggestion:@"Bins can be generated after genotypes have been called."];
+		[[NSAlert alertWithError:error] beginSheetModalForWindow:self.view.window completionHandler:^(NSModalResponse returnCode) {
+		}];
+		return;
+	}
+	
+	[self.view.undoManager setActionName:@"Generate Bins from Alleles"];
+	
+	/// The new bins replace the existing ones, which we delete first so that the new bins get unique names among their siblings.
+	NSManagedObjectContext *MOC = marker.managedObjectContext;
+	for(Bin *bin in marker.bins.allObjects) {
+		[MOC deleteObject:bin];
+	}
+	[MOC processPendingChanges];
+	
+	const ProposedBin *proposedBins = proposedBinData.bytes;
+	NSMutableArray *binsToCheck = NSMutableArray.new;
+	for (long i = 0; i < nBins; i++) {
+		/// The bin is created with its marker, so that it is named after its siblings.
+		Bin *newBin = [[Bin alloc] initWithStart:proposedBins[i].start end:proposedBins[i].end marker:marker];
+		if(newBin && proposedBins[i].issues != ProposedBinIssueNone) {
+			[binsToCheck addObject:newBin.name];
+		}
+	}
+	
+	/// Alleles may have been named after bins that no longer exist, so all genotypes are affected.
+	[marker updateGenotypeStatuses];
+	/// we allow the user to edit the new bins
+	marker.editState = editStateBins;
+	
+	if(binsToCheck.count > 0) {
+		NSString *description = binsToCheck.count > 1? [NSString stringWithFormat:@"%ld bins may need to be checked: %@.", binsToCheck.count, [binsToCheck componentsJoinedByString:@", "]] :
+		[NSString stringWithFormat:@"Bin %@ may need to be checked.", binsToCheck.firstObject];
+		NSError *error = [NSError errorWithDescription:description
+											suggestion:@"These bins may regroup several alleles, are not separated from others by a multiple of the repeat length, or had to be narrowed."];
+		[[NSAlert alertWithError:error] beginSheetModalForWindow:self.view.window completionHandler:^(NSModalResponse returnCode) {
+		}];
+	}
+}
+
+
+/// Computes the stutter statistics of our marker and shows the distributions of ratios to the user.
+-(void)showStutterStatistics:(id)sender {
+	Mmarker *marker = self.region;
+	[marker computeStutterStatistics];
+	const StutterStatistics *statistics = marker.stutterStatistics.bytes;
+	if(!statistics || statistics->nGenotypes == 0) {
+		NSError *error = [NSError errorWithDescription:@"No statistics could be computed because the marker has no called genotype."
+											suggestion:@"Statistics can be computed after genotypes have been called."];
+		[[NSAlert alertWithError:error] beginSheetModalForWindow:self.view.window completionHandler:^(NSModalResponse returnCode) {
+		}];
+		return;
+	}
+	
+	static NSArray<NSString *> *ratioNames;
+	if(!ratioNames) {
+		ratioNames = @[@"Stutter n-1", @"Stutter n+1", @"Stutter n-2", @"Peak at -1 bp", @"Heterozygote balance"];
+	}
+	NSMutableArray *lines = NSMutableArray.new;
+	for (StutterRatio ratio = 0; ratio < StutterRatioCount; ratio++) {
+		uint32_t count = numberOfStutterRatios(statistics, ratio);
+		if(count == 0) {
+			[lines addObject:[NSString stringWithFormat:@"%@: no data", ratioNames[ratio]]];
+			continue;
+		}
+		[lines addObject:[NSString stringWithFormat:@"%@: median %.2f, quartiles %.2f - %.2f, 5%% - 95%%: %.2f - %.2f (n = %u)",
+						  ratioNames[ratio],
+						  stutterRatioQuantile(statistics, ratio, 0.5),
+						  stutterRatioQuantile(statistics, ratio, 0.25),
+						  stutterRatioQuantile(statistics, ratio, 0.75),
+						  stutterRatioQuantile(statistics, ratio, 0.05),
+						  stutterRatioQuantile(statistics, ratio, 0.95),
+						  count]];
+	}
+	
+	float leftMaxDropOut = 0.7, rightMaxDropOut = 0.3;
+	adjustDropOutRatiosToStutterStatistics(statistics, &leftMaxDropOut, &rightMaxDropOut);
+	[lines addObject:[NSString stringWithFormat:@"\nAllele calling will ignore peaks lower than %.2f (shorter) or %.2f (longer) times an allele.", leftMaxDropOut, rightMaxDropOut]];
+	
+	NSAlert *alert = NSAlert.new;
+	alert.messageText = [NSString stringWithFormat:@"Height ratios at marker %@, from %u genotypes.", marker.name, statistics->nGenotypes];
+	alert.informativeText = [lines componentsJoinedByString:@"\n"];
+	[alert beginSheetModalForWindow:self.view.window completionHandler:^(NSModalResponse returnCode) {
+	}];
+}
+
+
 - (void)doubleClickAction:(id)sender {
 	/// when double-clicked, we show the popover that allows the user to edit our name, start and end positions
 	NSPoint mouseUpPoint = [layer convertPoint:self.view.mouseUpPoint fromLayer:self.view.layer];
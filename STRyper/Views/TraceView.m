@@ -1520,7 +1520,7 @@ static const int threshold = 1;   	/// height (in points) below which we do not
 
 
 - (CGFloat) yForScan:(uint) scan ofTrace:(Trace *)trace {
-	NSData *fluoData = _showRawData? trace.primitiveRawData : [trace adjustedDataMaintainingPeakHeights: _maintainPeakHeights];
+	NSData *fluoData = _showRawData? trace.rawData : [trace adjustedDataMaintainingPeakHeights: _maintainPeakHeights];
 	if(fluoData.length/sizeof(int16_t) > scan) {
 		const int16_t *fluo = fluoData.bytes;
 		return fluo[scan] * _vScale;
@@ -2127,7 +2127,7 @@ static const int threshold = 1;   	/// height (in points) below which we do not
 			const Peak *peaks = tracePeaks.bytes;
 			long nPeaks = tracePeaks.length/sizeof(Peak);
 			int minScan = sample.minScan, maxScan = sample.maxScan;
-			NSData *fluoData = useRawData? trace.primitiveRawData : [trace adjustedDataMaintainingPeakHeights:NO];
+			NSData *fluoData = useRawData? trace.rawData : [trace adjustedDataMaintainingPeakHeights:NO];
 			NSInteger nScans = fluoData.length/sizeof(int16_t);
 			const int16_t *fluo = fluoData.bytes;
 			for(int i = 0; i < nPeaks; i++) {
@@ -2152,7 +2152,7 @@ static const int threshold = 1;   	/// height (in points) below which we do not
 			if(size >= startSize && size <= endSize) {
 				Trace *trace = allele.trace;
 				int scan = allele.scan;
-				NSData *fluoData = useRawData? trace.primitiveRawData : [trace adjustedDataMaintainingPeakHeights:NO];
+				NSData *fluoData = useRawData? trace.rawData : [trace adjustedDataMaintainingPeakHeights:NO];
 				if(fluoData.length/sizeof(int16_t) > scan) {
 					const int16_t *fluo = fluoData.bytes;
 					int16_t fluoAtScan = fluo[scan];
@@ -2898,17 +2898,17 @@ static const int threshold = 1;   	/// height (in points) below which we do not
 	/// Note: this may not be the segment that is the closest to the point, but most of the time it should be.
 	for(Trace *trace in visibleTraces) {
 		Chromatogram *sample = trace.chromatogram;
-		int scan = [sample scanForSize:sizeAtPoint];
-		if(scan < 1 || scan >= sample.maxScan) {
+		/// The integer part of the fractional scan is the scan at the left of the point.
+		int leftScan = (int)[sample fractionalScanForSize:sizeAtPoint];
+		if(leftScan < 0 || leftScan+1 >= sample.maxScan) {
 			continue;
 		}
 		NSData *sizeData = sample.sizes;
 		long nScans = sizeData.length / sizeof(float);
-		if(nScans <= scan) {
+		if(nScans <= leftScan+1) {
 			continue;
 		}
 		const float *sizes = sizeData.bytes;
-		int leftScan = sizes[scan] > sizeAtPoint? scan-1 : scan;
 		float leftSize = sizes[leftScan];
 		float rightSize = sizes[leftScan+1];
 		
@@ -3012,10 +3012,8 @@ static const int threshold = 1;   	/// height (in points) below which we do not
 			
 			/// we check if we have room to add the new bin
 			CGFloat safePosition = position < clickedPosition? clickedPosition - 0.13 : clickedPosition + 0.13;
-			for(Bin *bin in marker.bins) {
-				if(safePosition >= bin.start && safePosition <= bin.end) {
-					return;
-				}
+			if([marker binForSize:safePosition]) {
+				return;
 			}
 			NSError *error;
 			draggedLabel = [enabledMarkerLabel labelWithNewBinByDraggingWithError:&error];